@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+
+// Heap allocation counters for the calling thread: global operator new plus
+// cv::Mat buffers (OpenCV allocates those with fastMalloc, not new).
+// Built only with MARKER_COUNT_ALLOCS (CMake option, default OFF); otherwise
+// all counters read zero.
+struct AllocStats {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+};
+
+AllocStats alloc_stats_thread();
+
+// Routes cv::Mat's default allocator through the counter. Call once at startup.
+void alloc_stats_install();
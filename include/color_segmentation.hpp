@@ -1,12 +1,84 @@
 #pragma once
 #include "types.hpp"
+#include "deadline.hpp"
+#include "frame_batch.hpp"
+#include "yuv_frame.hpp"
+#include <cstddef>
 #include <vector>
 #include <opencv2/opencv.hpp>
 
 struct SegmentationParams {
     double min_area_ratio = 0.0006; // relative to image area
     double max_area_ratio = 0.2;
+    // Thumbnail pre-rejection (prefilter.hpp); prefilter_side = 0 disables it.
+    int    prefilter_side = 64;          // longest thumbnail side (px)
+    double prefilter_color_frac = 0.005; // share of thumbnail pixels for a color to count
+    int    prefilter_min_colors = 3;     // palette colors that must be present
+    double prefilter_fill = 0.15;        // palette pixels needed, × coverage_thresh
+    size_t mem_budget = 0;               // bytes; picks a lower-memory strategy (mem_stats.hpp), 0 = off
+    // Staged retry (process_image) of frames whose candidates fail: the first
+    // pass is re-filtered with area bounds relaxed by this factor, then
+    // re-thresholded with widened bands. 0 = off.
+    double retry_area_scale = 0.0;
     bool   debug = false;
 };
 
-std::vector<Patch> segment_color_patches(const cv::Mat& bgr, const SegmentationParams& params);
+// dl (optional): checked between stages; on expiry returns what it has so far
+// and dl->tripped() is set. Uses DefaultPalette.
+std::vector<Patch> segment_color_patches(const cv::Mat& bgr, const SegmentationParams& params,
+                                         const Deadline* dl = nullptr);
+
+// Same, specialized for a compile-time palette (palette.hpp). Instantiated in
+// color_segmentation.cpp; a new marker variant adds its instantiation there.
+template<class Palette>
+std::vector<Patch> segment_color_patches_t(const cv::Mat& bgr, const SegmentationParams& params,
+                                           const Deadline* dl = nullptr);
+
+// Every frame of a micro-batch (frame_batch.hpp) at once: color conversion,
+// blur, classification and morphology each run as one call over the packed
+// buffer, then contours are traced per frame. out[i] matches
+// segment_color_patches(batch.frame(i)) (no deadline, no memory budget).
+// active (optional, one flag per frame): frames to trace; others stay empty.
+std::vector<std::vector<Patch>> segment_color_patches_batch(const FrameBatch& batch, const SegmentationParams& params,
+                                                            const std::vector<bool>& active = {});
+
+// Band widening of the re-threshold retry (WidenedPalette, palette.hpp): hue
+// ±5 steps, saturation and value floors 20 lower.
+constexpr int kRetryHueWiden = 5, kRetrySatWiden = 20, kRetryValWiden = 20;
+
+// First segmentation pass kept for the staged retry. hsv lives in the
+// caller's ArenaScope (frame_arena.hpp), which must outlive the retries.
+// patches are traced down to the relaxed area bounds; the first attempt
+// filters them back to the normal ones (filter_patches_by_area).
+struct KeptPass {
+    cv::Mat hsv;                    // blurred HSV image
+    std::vector<Patch> patches;     // area ratio in [min / retry_area_scale, max × retry_area_scale]
+};
+void segment_color_patches_keep(const cv::Mat& bgr, const SegmentationParams& params, KeptPass& out,
+                                const Deadline* dl = nullptr);
+
+// Patches whose area is within [min_ratio, max_ratio] × image area, ids renumbered
+// in order (as if traced with those bounds).
+std::vector<Patch> filter_patches_by_area(const std::vector<Patch>& patches, const cv::Size& img_size,
+                                          double min_ratio, double max_ratio);
+
+// Re-threshold of a kept pass with every band widened, relaxed area bounds.
+std::vector<Patch> segment_widened(const KeptPass& pass, const SegmentationParams& params,
+                                   const Deadline* dl = nullptr);
+
+// A 4:2:0 frame (yuv_frame.hpp) classified from its planes through the
+// palette's YUV table (yuv_classify.hpp): no BGR or HSV image. Luma is
+// blurred and chroma interpolated as smooth_yuv_planes() describes. Masks,
+// cleaning and contours are as in segment_color_patches, so patches match the
+// BGR path's on the converted frame up to the table's quantization and the
+// blur's color space (tools/yuv_compare). No memory budget.
+std::vector<Patch> segment_color_patches_yuv(const YuvPlanes& frame, const SegmentationParams& params,
+                                             const Deadline* dl = nullptr);
+
+template<class Palette>
+std::vector<Patch> segment_color_patches_yuv_t(const YuvPlanes& frame, const SegmentationParams& params,
+                                               const Deadline* dl = nullptr);
+
+template<class Palette>
+std::vector<std::vector<Patch>> segment_color_patches_batch_t(const FrameBatch& batch, const SegmentationParams& params,
+                                                              const std::vector<bool>& active = {});
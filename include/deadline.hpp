@@ -0,0 +1,59 @@
+#pragma once
+#include <chrono>
+
+// Cooperative per-image latency budget. Stages poll expired() between steps
+// and return early; the pipeline decides whether to degrade or give up.
+// A default-constructed Deadline is inactive and never expires.
+class Deadline {
+public:
+    using clock = std::chrono::steady_clock;
+
+    Deadline() = default;
+
+    static Deadline in_ms(double ms, clock::time_point from = clock::now()) {
+        Deadline d;
+        d.start_ = from;
+        d.end_ = from + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::milli>(ms));
+        d.active_ = true;
+        return d;
+    }
+
+    bool active() const { return active_; }
+
+    // Latches: once a stage sees the deadline pass, tripped() stays true.
+    bool expired() const {
+        if (active_ && !tripped_ && clock::now() >= end_) tripped_ = true;
+        return tripped_;
+    }
+    bool tripped() const { return tripped_; }
+
+    // A stage did less than its full-quality work to stay within the budget
+    // (fewer k-means attempts, half resolution). Such results depend on the
+    // budget and must not be cached or journaled.
+    void mark_degraded() const { degraded_ = true; }
+    bool degraded() const { return degraded_ || tripped_; }
+
+    double remaining_ms() const {
+        if (!active_) return 1e300;
+        return std::chrono::duration<double, std::milli>(end_ - clock::now()).count();
+    }
+
+    // Less than `fraction` of the total budget left -> skip optional work.
+    bool at_risk(double fraction) const {
+        if (!active_) return false;
+        return remaining_ms() < fraction * std::chrono::duration<double, std::milli>(end_ - start_).count();
+    }
+
+    // Sub-deadline that ends after `fraction` of the remaining time.
+    Deadline slice(double fraction) const {
+        if (!active_) return Deadline();
+        double rem = remaining_ms();
+        return Deadline::in_ms(rem > 0 ? rem * fraction : 0.0);
+    }
+
+private:
+    clock::time_point start_{}, end_{};
+    bool active_ = false;
+    mutable bool tripped_ = false;
+    mutable bool degraded_ = false;
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Reports files that become complete in one directory (not recursive): closed
+// after writing (IN_CLOSE_WRITE) or renamed into it (IN_MOVED_TO, the usual
+// write-to-temp-then-rename upload). Dot files are ignored, so ".name.part"
+// temporaries never show up. Linux inotify; open() fails elsewhere.
+class DirWatcher {
+public:
+    DirWatcher() = default;
+    ~DirWatcher() { close(); }
+    DirWatcher(const DirWatcher&) = delete;
+    DirWatcher& operator=(const DirWatcher&) = delete;
+
+    bool open(const std::string& dir);
+    void close();
+
+    // Waits up to timeout_ms and appends the paths of newly completed files.
+    // Returns false once the directory is gone or the watch failed; a signal
+    // just ends the wait early. After a kernel queue overflow the whole
+    // directory is listed again, so a file can be reported twice (as it can
+    // by list() and a close racing it); callers dedupe.
+    bool wait(std::vector<std::string>& out, int timeout_ms);
+
+    // Regular, non-hidden files currently in the directory (startup backlog).
+    std::vector<std::string> list() const;
+
+private:
+    std::string dir_;
+    int fd_ = -1;
+    int wd_ = -1;
+};
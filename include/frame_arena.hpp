@@ -0,0 +1,70 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+// Per-thread monotonic arena for the transient buffers of one image
+// (masks, HSV copy, k-means samples, candidate lists). Allocation is a pointer
+// bump; everything is dropped at once when the outermost ArenaScope exits.
+// The first block grows to the high-water mark, so steady state does no heap
+// allocation at all. Nothing allocated here may outlive the image.
+// The block stays resident between images and is charged to mem_stats as
+// such (plus any overflow chunks while an image runs), not per allocation.
+class FrameArena {
+public:
+    static FrameArena& local();   // the calling thread's arena
+
+    std::pmr::memory_resource* resource() { return &counting_; }
+
+    // cv::Mat header over arena memory (no refcount, no heap).
+    cv::Mat mat(int rows, int cols, int type);
+
+    // Largest first block kept between images (0 = no limit, the default).
+    // --mem-budget sets it to the budget: a bigger image overflows into
+    // chunks that are freed at reset, and a larger block is shrunk to the
+    // limit at the next reset.
+    void set_block_limit(size_t bytes) { block_limit_ = bytes; }
+
+    // Cumulative counters (never reset) - diff them around a call.
+    uint64_t allocs() const { return counting_.allocs; }
+    uint64_t bytes()  const { return counting_.bytes; }
+
+private:
+    friend class ArenaScope;
+    FrameArena();
+    void reset();
+
+    struct Counting : std::pmr::memory_resource {
+        FrameArena* owner = nullptr;
+        uint64_t allocs = 0, bytes = 0;
+        size_t since_reset = 0;
+        size_t charged = 0;       // resident bytes charged to mem_stats
+        void track(size_t resident);
+        void* do_allocate(size_t n, size_t align) override;
+        void  do_deallocate(void*, size_t, size_t) override {} // monotonic
+        bool  do_is_equal(const std::pmr::memory_resource& o) const noexcept override { return this == &o; }
+    };
+
+    std::vector<unsigned char> block_;
+    std::optional<std::pmr::monotonic_buffer_resource> mono_;
+    Counting counting_;
+    size_t block_limit_ = 0;
+    int depth_ = 0;
+};
+
+// Marks one image's worth of arena use; the outermost scope resets the arena.
+class ArenaScope {
+public:
+    ArenaScope() : a_(FrameArena::local()) { ++a_.depth_; }
+    ~ArenaScope() { if (--a_.depth_ == 0) a_.reset(); }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+    FrameArena& arena() { return a_; }
+private:
+    FrameArena& a_;
+};
+
+template<class T> using arena_vector = std::pmr::vector<T>;
@@ -0,0 +1,43 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+
+// Spare rows before, between and after the frames of a batch.
+constexpr int kBatchGapRows = 2;
+
+// Frames up to this size are worth batching (--batch): beyond it the per-call
+// overhead is small next to the per-pixel work.
+constexpr int kBatchMaxFramePixels = 640 * 480;
+
+// Micro-batch of same-sized BGR frames (preview thumbnails) packed top to
+// bottom into one contiguous buffer, kBatchGapRows spare rows around each, so
+// that cvtColor / blur / morphology run once for the whole batch
+// (segment_color_patches_batch). The spare rows are what lets every frame still
+// see its own image border. The buffer is kept across clear() and reused while
+// the frame size does not change.
+class FrameBatch {
+public:
+    explicit FrameBatch(int capacity);
+
+    // CV_8UC3, at least 2 rows, the batch's frame size, and room left.
+    bool accepts(const cv::Mat& bgr) const;
+    bool add(const cv::Mat& bgr);      // copies; false when !accepts(bgr)
+    void clear() { n_ = 0; }
+
+    int  size() const { return n_; }
+    int  capacity() const { return cap_; }
+    bool empty() const { return n_ == 0; }
+    bool full() const { return n_ == cap_; }
+    cv::Size frame_size() const { return frame_; }
+
+    // Buffer row of frame i's first row; frame_top(size()) is the packed height.
+    int frame_top(int i) const { return kBatchGapRows + i * (frame_.height + kBatchGapRows); }
+    cv::Mat frame(int i) const { return buf_.rowRange(frame_top(i), frame_top(i) + frame_.height); }
+    // The used part of the buffer, gap rows included.
+    cv::Mat packed() const { return buf_.rowRange(0, frame_top(n_)); }
+
+private:
+    cv::Mat buf_;
+    cv::Size frame_;
+    int n_ = 0;
+    int cap_;
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+
+struct FrameGateParams {
+    int    side = 32;          // frames are compared as side×side grayscale thumbnails
+    double threshold = 2.0;    // mean absolute difference (0..255) counted as "unchanged"
+    int    max_skip = 30;      // at most this many consecutive frames reuse one result
+};
+
+// Cheap change detector for video streams. A frame is compared against the
+// last frame that went through full detection (not the previous frame), so
+// slow drift still trips the gate eventually.
+class FrameGate {
+public:
+    explicit FrameGate(const FrameGateParams& p = FrameGateParams()) : p_(p) {}
+
+    // true -> reuse the previous result. false -> run detection; the frame
+    // becomes the new reference.
+    bool unchanged(const cv::Mat& bgr);
+
+    // Drop the reference (e.g. the last detection timed out).
+    void invalidate() { has_ref_ = false; }
+
+    size_t skipped() const { return skipped_; }
+    size_t frames() const { return frames_; }
+
+private:
+    FrameGateParams p_;
+    cv::Mat ref_;
+    bool has_ref_ = false;
+    int since_ref_ = 0;
+    size_t skipped_ = 0, frames_ = 0;
+};
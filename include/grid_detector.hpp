@@ -1,5 +1,6 @@
 #pragma once
 #include "types.hpp"
+#include "deadline.hpp"
 #include <opencv2/opencv.hpp>
 
 struct GridParams {
@@ -8,12 +9,43 @@ struct GridParams {
     float coverage_thresh  = 0.45f;
     float coverage_fallback= 0.55f;
     float coverage_soft    = 0.50f;
+    float group_link = 2.5f;   // multi-marker: link patches closer than this × mean patch side
+    // Pre-checks (precheck_candidates); 0 disables a check. Both are off until
+    // a marker_tune sweep over labeled images shows they add no false negatives.
+    int   min_colors = 0;      // distinct palette colors among the candidates (e.g. 3)
+    float area_compat = 0.f;   // 9 candidates must lie within this area factor of each other (e.g. 25)
     bool  debug = false;
 };
 
+// Cascade of cheap rejections run before any clustering, cheapest first:
+//   FEW_COMPATIBLE - fewer than 9 candidates, or no 9 with areas within
+//                    area_compat of each other (a grid needs 9 similar cells)
+//   FEW_COLORS     - fewer than min_colors distinct colors
+//   SMALL_SPREAD   - the bounding box of all candidate boxes is smaller than
+//                    coverage_thresh × image area, so no hull can reach it
+// SMALL_SPREAD and the count only reject what the full detector would reject
+// too; the color and area tests are marker assumptions, off by default. Holds for the multi-
+// marker search as well (every accepted marker passes them on its own).
+FailureReason precheck_candidates(const std::vector<Patch>& patches,
+                                  const cv::Size& img_size,
+                                  const GridParams& params);
+
 // Runs PCA, row/col KMeans, greedy assignment, spacing checks.
 // Fills GridDetection and returns FailureReason (or NONE).
+// dl (optional): TIMEOUT once expired; k-means restarts drop to one when at risk.
 FailureReason detect_grid_and_spacing(
     const std::vector<Patch>& patches,
     GridDetection& out,
-    const GridParams& params);
+    const GridParams& params,
+    const Deadline* dl = nullptr);
+
+// Multi-marker variant: groups patches by proximity (shared segmentation),
+// runs the 3×3 detector on every group that can hold a grid and keeps all
+// non-overlapping grids. Falls back to a single detection over all patches
+// when grouping yields nothing, so single-marker frames behave as before.
+// Returned grids keep the caller's Patch::id; rot is indexed by that id.
+FailureReason detect_all_grids(
+    const std::vector<Patch>& patches,
+    std::vector<GridDetection>& out,
+    const GridParams& params,
+    const Deadline* dl = nullptr);
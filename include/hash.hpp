@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+// Fast non-cryptographic 64-bit hash (8 bytes per step + splitmix finalizer).
+// Stable across runs and machines: used for cache keys and sharding.
+inline uint64_t hash_mix64(uint64_t x) {
+    x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27; x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+inline uint64_t hash64(const void* data, size_t len, uint64_t seed = 0) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t h = seed ^ (0x9E3779B97F4A7C15ULL * (uint64_t)(len + 1));
+    while (len >= 8) {
+        uint64_t k; std::memcpy(&k, p, 8);
+        h ^= hash_mix64(k);
+        h = (h << 27 | h >> 37) * 0xC2B2AE3D27D4EB4FULL + 0x165667B19E3779F9ULL;
+        p += 8; len -= 8;
+    }
+    uint64_t tail = 0;
+    if (len) std::memcpy(&tail, p, len);
+    h ^= hash_mix64(tail ^ len);
+    return hash_mix64(h);
+}
+
+inline uint64_t hash_combine(uint64_t h, uint64_t v) {
+    return hash_mix64(h ^ (v + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2)));
+}
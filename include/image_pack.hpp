@@ -0,0 +1,64 @@
+#pragma once
+#include "mapped_file.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Packed image archive (.mkpack, tools/marker_pack): many small encoded files
+// concatenated into one, so a dataset costs one open + one mapping instead of
+// an open/stat/read per image. Layout:
+//   32-byte header ("MKIMGPK1", version, count, index offset)
+//   the files' bytes as they were, each starting 64-byte aligned
+//   index: count × 32-byte entries (offset, size, hash64 of the bytes,
+//          name length), then the names back to back
+// The index sits at the end so the packer can stream; the stored hash is the
+// result cache key (result_cache.hpp), so a cache hit never touches the bytes.
+
+// How far ahead of the decode cursor pages are requested (--pack).
+constexpr size_t kPackPrefetchBytes = 32u << 20;
+
+class ImagePack {
+public:
+    bool open(const std::string& path);   // maps it with sequential readahead
+    void close();
+
+    size_t size() const { return entries_.size(); }
+    const std::string& name(size_t i) const { return entries_[i].name; }
+    const unsigned char* data(size_t i) const { return map_.data() + entries_[i].offset; }
+    size_t bytes(size_t i) const { return (size_t)entries_[i].size; }
+    uint64_t content_hash(size_t i) const { return entries_[i].hash; }
+
+    // Paging hints, driven by the caller's processing order.
+    void prefetch(size_t i) const { map_.will_need((size_t)entries_[i].offset, bytes(i)); }
+    void release(size_t i) const { map_.dont_need((size_t)entries_[i].offset, bytes(i)); }
+
+private:
+    struct Entry {
+        std::string name;
+        uint64_t offset, size, hash;
+    };
+    MappedFile map_;
+    std::vector<Entry> entries_;
+};
+
+// Builds a pack in "<path>.tmp" and renames it into place on finish(), so an
+// interrupted run never leaves a pack that looks valid.
+class ImagePackWriter {
+public:
+    bool open(const std::string& path);
+    bool add(const std::string& name, const unsigned char* data, size_t size);
+    bool finish();
+    size_t count() const { return entries_.size(); }
+
+private:
+    struct Entry {
+        std::string name;
+        uint64_t offset, size, hash;
+    };
+    std::string path_;
+    std::ofstream out_;
+    uint64_t pos_ = 0;
+    std::vector<Entry> entries_;
+};
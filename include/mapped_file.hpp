@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file (POSIX mmap / Win32 file mapping).
+// Empty files map to data()==nullptr, size()==0.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool is_open() const { return open_; }
+
+    // Paging hints for a byte range (widened to whole pages); no-ops on Windows.
+    void advise_sequential() const;                        // aggressive readahead
+    void will_need(size_t offset, size_t len) const;       // start reading it in now
+    void dont_need(size_t offset, size_t len) const;       // done with it: drop from this mapping
+
+private:
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+    bool open_ = false;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
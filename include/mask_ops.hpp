@@ -0,0 +1,44 @@
+#pragma once
+#include "palette.hpp"
+#include <opencv2/opencv.hpp>
+
+// Building blocks shared by the whole-image and strip segmenters.
+
+// Open + close with a 3×3 ellipse: removes speckle, fills pinholes.
+// Each of the four passes reads one row above/below (2 rows per op pair).
+inline void clean_mask(cv::Mat& mask) {
+    static const cv::Mat k = cv::getStructuringElement(cv::MORPH_ELLIPSE, {3,3});
+    cv::morphologyEx(mask, mask, cv::MORPH_OPEN, k);
+    cv::morphologyEx(mask, mask, cv::MORPH_CLOSE, k);
+}
+
+// Rows of context a strip needs on each side for blur (1) + clean_mask (4)
+// to produce exactly the whole-image result in its interior.
+constexpr int kMaskHaloRows = 5;
+
+// One pass over the HSV image writes every color mask (0/255), replacing one
+// inRange per band plus the red OR. Masks must be preallocated CV_8UC1 of the
+// image size.
+template<class P>
+inline void classify_masks(const cv::Mat& hsv, cv::Mat (&masks)[P::kColors]) {
+    for (int y = 0; y < hsv.rows; ++y) {
+        const unsigned char* p = hsv.ptr<unsigned char>(y);
+        unsigned char* out[P::kColors];
+        for (int c = 0; c < P::kColors; ++c) out[c] = masks[c].template ptr<unsigned char>(y);
+        for (int x = 0; x < hsv.cols; ++x, p += 3) {
+            const unsigned bits = classify_hsv<P>(p[0], p[1], p[2]);
+            for (int c = 0; c < P::kColors; ++c) out[c][x] = (unsigned char)(0u - ((bits >> c) & 1u));
+        }
+    }
+}
+
+// Single-color variant for the low-memory path: only masks one palette color.
+template<class P>
+inline void classify_mask(const cv::Mat& hsv, int color, cv::Mat& mask) {
+    for (int y = 0; y < hsv.rows; ++y) {
+        const unsigned char* p = hsv.ptr<unsigned char>(y);
+        unsigned char* out = mask.ptr<unsigned char>(y);
+        for (int x = 0; x < hsv.cols; ++x, p += 3)
+            out[x] = (unsigned char)(0u - ((classify_hsv<P>(p[0], p[1], p[2]) >> color) & 1u));
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "stage_profiler.hpp"
+#include <cstddef>
+#include <opencv2/opencv.hpp>
+
+// Peak-memory accounting for the calling thread's current image. Live bytes
+// come from the frame arena (its resident block), cv::Mat heap buffers (with
+// MARKER_COUNT_ALLOCS, including OpenCV's internal temporaries) and explicit
+// MemCharge scopes for std::vector outputs such as contours and patch lists.
+// Every StageTimer scope records the high-water mark reached while it was open.
+struct MemPeaks {
+    size_t total = 0;                          // whole image, decode included
+    size_t stage[(int)Stage::Count] = {};      // high-water inside each stage
+};
+
+void mem_image_begin();          // peaks restart from the bytes live right now
+MemPeaks mem_image_peaks();
+
+void mem_track_alloc(size_t n);
+void mem_track_free(size_t n);
+
+// Keeps `bytes` charged until destroyed; set() adjusts the charge.
+class MemCharge {
+public:
+    MemCharge() = default;
+    explicit MemCharge(size_t bytes) { set(bytes); }
+    ~MemCharge() { set(0); }
+    MemCharge(const MemCharge&) = delete;
+    MemCharge& operator=(const MemCharge&) = delete;
+    void set(size_t bytes);
+private:
+    size_t bytes_ = 0;
+};
+
+// Used by StageTimer: begin returns the enclosing peak, end folds it back.
+size_t mem_stage_begin();
+void   mem_stage_end(Stage s, size_t saved);
+
+// --mem-budget: cheapest strategy that fits, from the image size alone.
+//   Full     - HSV copy + every color mask at once (fastest)
+//   PerColor - HSV copy + one mask, classified/cleaned/traced color by color
+//   Strips   - nothing image-sized: decode and segment strip_rows at a time
+enum class MemStrategy { Full, PerColor, Strips };
+
+struct MemPlan {
+    MemStrategy strategy = MemStrategy::Full;
+    int strip_rows = 0;          // Strips only
+    size_t estimate = 0;         // expected peak bytes, decode included
+    bool fits = true;            // false: even one-row strips exceed the budget
+};
+
+MemPlan plan_memory(const cv::Size& size, size_t budget_bytes);
+const char* mem_strategy_name(MemStrategy s);
@@ -0,0 +1,48 @@
+#pragma once
+#include "types.hpp"
+#include "stage_profiler.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+// Live telemetry for long runs (main --metrics): images per outcome
+// (FailureReason) with latency histograms, per-stage duration histograms and
+// processed pixels. Each thread updates its own block of counters with plain
+// relaxed atomic stores (single writer: no locks, no shared cache lines);
+// readers sum the blocks. Disabled -> recording costs one branch.
+void metrics_enable();
+bool metrics_enabled();
+
+void metrics_record_image(FailureReason fr, double ms);
+void metrics_record_stage(Stage s, long long ns);   // from StageTimer
+void metrics_add_pixels(size_t pixels);
+
+// Prometheus text exposition format, every thread's counters summed.
+void metrics_write(std::ostream& os);
+
+// Writes metrics_write() to `path` every interval_s from a background thread,
+// for node_exporter's textfile collector: the text goes to "<path>.tmp" and is
+// renamed over `path`, so a scrape never sees a half-written file. The path
+// should end in ".prom" (the collector ignores the ".tmp").
+class MetricsExporter {
+public:
+    MetricsExporter(const std::string& path, double interval_s);  // enables metrics
+    ~MetricsExporter();             // one last write, then joins
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    bool write_now();
+
+private:
+    void run();
+
+    std::string path_;
+    double interval_s_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread worker_;
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include "pipeline.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <opencv2/opencv.hpp>
+
+struct OverlayParams {
+    std::string dir;                // output directory (must exist)
+    int    every = 1;               // sample every Nth image
+    bool   failures_only = false;   // only images that were not accepted
+    size_t queue = 8;               // pending overlays; more are dropped
+    int    side = 800;              // longest side of the rendered overlay (px)
+};
+
+// Debug overlays (all candidate patches, grid assignment, coverage hull) drawn,
+// PNG-encoded and written by one background thread. submit() only copies what
+// it needs into a bounded queue and never waits: when the writer falls behind,
+// the overlay is dropped, so per-image timings are not skewed by the I/O.
+class OverlayWriter {
+public:
+    explicit OverlayWriter(const OverlayParams& p);
+    ~OverlayWriter();               // writes what is queued, then joins
+    OverlayWriter(const OverlayWriter&) = delete;
+    OverlayWriter& operator=(const OverlayWriter&) = delete;
+
+    // Sampling decision for the index-th image (0-based).
+    bool wants(size_t index, bool ok) const;
+
+    // A file input: the worker decodes it again, so nothing image-sized is
+    // copied on the caller's thread.
+    bool submit_file(const std::string& path, const ImageResult& res);
+    // A frame that will not outlive the call (video, shared memory): copied.
+    bool submit_frame(const std::string& name, const cv::Mat& bgr, const ImageResult& res);
+
+    size_t written() const;
+    size_t dropped() const;
+
+private:
+    struct Job {
+        std::string name;           // output name / source path
+        bool from_file = false;
+        cv::Mat bgr;
+        ImageResult res;
+    };
+
+    bool push(Job&& job);
+    void run();
+    void render_and_write(Job& job);
+
+    OverlayParams p_;
+    mutable std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<Job> q_;
+    bool stop_ = false;
+    size_t written_ = 0, dropped_ = 0;
+    std::thread worker_;
+};
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+
+// Marker palettes as compile-time tables: OpenCV HSV ranges (H 0..180),
+// bounds inclusive as in cv::inRange. Red wraps around hue 0 and therefore
+// has two bands. Everything that consumes a palette is a template over the
+// palette type, so each palette gets its own straight-line classifier.
+//
+// A palette type provides:
+//   static constexpr int     kColors;          // <= 8 (one bit per color)
+//   static constexpr const char* names[kColors];
+//   static constexpr HsvBand bands[];         // any number, band.color < kColors
+struct HsvBand {
+    int color;                  // index into names
+    unsigned char lo[3], hi[3]; // H,S,V
+};
+
+// The 6-color marker (red, green, blue, yellow, cyan, magenta).
+struct SixColorPalette {
+    static constexpr int kColors = 6;
+    static constexpr const char* names[kColors] = {
+        "red", "green", "blue", "yellow", "cyan", "magenta"
+    };
+    static constexpr HsvBand bands[] = {
+        { 0, {  0, 80, 60 }, { 10, 255, 255 } },
+        { 0, {170, 80, 60 }, {180, 255, 255 } },
+        { 1, { 35, 60, 60 }, { 85, 255, 255 } },
+        { 2, { 90, 60, 60 }, {130, 255, 255 } },
+        { 3, { 20, 60, 60 }, { 35, 255, 255 } },
+        { 4, { 80, 60, 60 }, { 95, 255, 255 } },
+        { 5, {140, 60, 60 }, {170, 255, 255 } },
+    };
+};
+
+using DefaultPalette = SixColorPalette;
+
+template<class P>
+constexpr size_t palette_band_count() { return sizeof(P::bands) / sizeof(P::bands[0]); }
+
+// Branch-free so the per-pixel loops vectorize.
+constexpr unsigned hsv_in_band(const HsvBand& b, unsigned h, unsigned s, unsigned v) {
+    return (unsigned)((h >= b.lo[0]) & (h <= b.hi[0]) &
+                      (s >= b.lo[1]) & (s <= b.hi[1]) &
+                      (v >= b.lo[2]) & (v <= b.hi[2]));
+}
+
+template<class P, size_t... I>
+constexpr unsigned classify_hsv_impl(unsigned h, unsigned s, unsigned v, std::index_sequence<I...>) {
+    return (0u | ... | (hsv_in_band(P::bands[I], h, s, v) << P::bands[I].color));
+}
+
+// Bit c set <=> pixel lies in one of color c's bands. Colors may overlap
+// (e.g. hue 35 is both green and yellow), exactly like separate inRange masks.
+template<class P>
+constexpr unsigned classify_hsv(unsigned h, unsigned s, unsigned v) {
+    static_assert(P::kColors <= 8, "palette bits must fit a byte");
+    return classify_hsv_impl<P>(h, s, v, std::make_index_sequence<palette_band_count<P>()>{});
+}
+
+// P with every band widened: hue by DH steps each way (clamped to 0..180),
+// saturation and value floors lowered by DS / DV. Same colors and names, so
+// its masks stand in for P's (the staged retry in pipeline.cpp).
+constexpr HsvBand widen_band(const HsvBand& b, int dh, int ds, int dv) {
+    auto lower = [](int v, int d) { return (unsigned char)(v - d < 0 ? 0 : v - d); };
+    auto raise = [](int v, int d) { return (unsigned char)(v + d > 180 ? 180 : v + d); };
+    return HsvBand{ b.color, { lower(b.lo[0], dh), lower(b.lo[1], ds), lower(b.lo[2], dv) },
+                             { raise(b.hi[0], dh), b.hi[1], b.hi[2] } };
+}
+
+template<class P, int DH, int DS, int DV, class Seq = std::make_index_sequence<palette_band_count<P>()>>
+struct WidenedPalette;
+
+template<class P, int DH, int DS, int DV, size_t... I>
+struct WidenedPalette<P, DH, DS, DV, std::index_sequence<I...>> {
+    static constexpr int kColors = P::kColors;
+    static constexpr const char* const (&names)[kColors] = P::names;
+    static constexpr HsvBand bands[] = { widen_band(P::bands[I], DH, DS, DV)... };
+};
+
+static_assert(classify_hsv<SixColorPalette>(5, 200, 200) == 0x01, "red");
+static_assert(classify_hsv<SixColorPalette>(35, 200, 200) == 0x0A, "green|yellow overlap");
+static_assert(classify_hsv<SixColorPalette>(60, 10, 200) == 0, "unsaturated");
+static_assert(classify_hsv<WidenedPalette<SixColorPalette, 5, 20, 20>>(14, 200, 200) == 0x01, "widened red");
+static_assert(classify_hsv<WidenedPalette<SixColorPalette, 5, 20, 20>>(60, 45, 45) == 0x02, "widened green");
@@ -0,0 +1,88 @@
+#pragma once
+#include "types.hpp"
+#include "color_segmentation.hpp"
+#include "grid_detector.hpp"
+#include "coverage.hpp"
+#include "deadline.hpp"
+#include "strip_source.hpp"
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// One evaluated 3×3 grid: coverage + the threshold/fallback decision.
+struct MarkerResult {
+    bool ok = false;
+    FailureReason fr = FailureReason::NONE;
+    GridDetection gd;
+    CoverageResult cov;
+};
+
+// Which staged retry (process_image, SegmentationParams::retry_area_scale)
+// recovered an image: same contours with relaxed area bounds, or the kept
+// HSV image re-thresholded with widened bands.
+enum class RetryStage { None = 0, RelaxedArea = 1, WidenedBands = 2 };
+const char* retry_stage_name(RetryStage s);
+
+// Everything main needs to report one image.
+struct ImageResult {
+    bool ok = false;                    // at least one marker accepted
+    FailureReason fr = FailureReason::NONE;
+    size_t patch_count = 0;
+    std::vector<Patch> patches;         // segmentation candidates (empty on cache hits)
+    std::vector<MarkerResult> markers;  // every evaluated grid, accepted ones first
+    RetryStage retry = RetryStage::None; // staged retry that produced an accepted result
+    bool degraded = false;              // cut short by the deadline (Deadline::degraded): not cacheable
+    double coord_scale = 1.0;           // patches/markers are in image coordinates × this (0.5: half-res fallback)
+};
+
+// The parameters SodyoAssignment runs with before its flags apply. The tools/
+// checks start from these too, so they compare against what main does.
+SegmentationParams default_segmentation_params();
+GridParams default_grid_params();
+
+// The FR-6 decision alone: spacing verdict + coverage fallbacks vs thresholds.
+// Pure arithmetic, so parameter sweeps (tools/marker_tune) can re-run it per trial.
+bool grid_accepted(bool spacing_ok, float cvx, float cvy, double coverage_ratio, const GridParams& params);
+
+// Coverage (convex hull vs image area) + spacing/coverage fallbacks (FR-5/FR-6).
+MarkerResult evaluate_grid(const GridDetection& gd, const cv::Size& img_size, const GridParams& params);
+
+// Segmentation -> grid detection -> coverage -> decision.
+// multi=true reports every non-overlapping marker (segmentation is shared).
+// dl (optional): full-resolution segmentation gets part of the budget; if it
+// does not finish in time it is redone once at half resolution, and a run
+// that still misses the deadline ends with FailureReason::TIMEOUT.
+// With segp.retry_area_scale > 0, candidate failures (FEW_PATCHES,
+// ASSIGN_GRID and the pre-check reasons) are retried on the first pass's
+// kept contours and HSV image instead of from decode.
+ImageResult process_image(const cv::Mat& bgr,
+                          const SegmentationParams& segp,
+                          const GridParams& gp,
+                          bool multi = false,
+                          const Deadline* dl = nullptr);
+
+// Same decision for a 4:2:0 camera/decoder frame (yuv_frame.hpp), classified
+// from its planes without a BGR conversion (segment_color_patches_yuv). On a
+// missed deadline there is no half-resolution retry: the result is TIMEOUT.
+ImageResult process_image_yuv(const YuvPlanes& frame,
+                              const SegmentationParams& segp,
+                              const GridParams& gp,
+                              bool multi = false,
+                              const Deadline* dl = nullptr);
+
+// Same decision for an image read strip by strip (strip_segmentation.hpp):
+// peak memory follows strip_rows × width rather than the image size.
+ImageResult process_image_strips(StripSource& src,
+                                 const SegmentationParams& segp,
+                                 const GridParams& gp,
+                                 int strip_rows,
+                                 bool multi = false,
+                                 const Deadline* dl = nullptr);
+
+// Every frame of a micro-batch (frame_batch.hpp): thumbnail pre-rejection per
+// frame, one batched segmentation, then grid detection and coverage per frame.
+// Same decisions as process_image on each frame alone; no deadline or memory
+// budget. out[i] belongs to batch.frame(i).
+std::vector<ImageResult> process_batch(const FrameBatch& batch,
+                                       const SegmentationParams& segp,
+                                       const GridParams& gp,
+                                       bool multi = false);
@@ -0,0 +1,45 @@
+#pragma once
+#include "color_segmentation.hpp"
+#include <opencv2/opencv.hpp>
+
+// Cheap first stage: classify a tiny INTER_AREA thumbnail against the palette
+// and check that enough distinct colors, and enough colored area overall,
+// exist to possibly form a marker covering coverage_thresh of the image.
+// false -> the frame can be rejected (FEW_PATCHES) without full segmentation.
+// Uses DefaultPalette.
+bool prefilter_may_contain_marker(const cv::Mat& bgr, const SegmentationParams& params, float coverage_thresh);
+
+// Same test on a 4:2:0 frame: the luma and chroma planes are shrunk to the
+// thumbnail separately and classified through the YUV table.
+bool prefilter_may_contain_marker_yuv(const YuvPlanes& frame, const SegmentationParams& params, float coverage_thresh);
+
+// The thumbnail statistics behind the decision. Computed once, they can be
+// re-checked for any coverage_thresh (tools/marker_tune sweeps it):
+// prefilter_passes_t(prefilter_counts_t<P>(bgr, params), params, t) is
+// prefilter_may_contain_marker_t<P>(bgr, params, t).
+template<class Palette>
+struct PrefilterCounts {
+    int per_color[Palette::kColors] = {0};
+    int colored = 0;                  // pixels with any palette color
+    int pixels = 0;                   // thumbnail size; 0 = not computed (passes)
+    void add(unsigned bits) {
+        if (!bits) return;
+        ++colored;
+        for (int c = 0; c < Palette::kColors; ++c) per_color[c] += (bits >> c) & 1u;
+    }
+};
+
+template<class Palette>
+PrefilterCounts<Palette> prefilter_counts_t(const cv::Mat& bgr, const SegmentationParams& params);
+
+template<class Palette>
+bool prefilter_passes_t(const PrefilterCounts<Palette>& counts, const SegmentationParams& params, float coverage_thresh);
+
+// Same tests for a compile-time palette (palette.hpp), which must be the one
+// the frame is then segmented with. Instantiated in prefilter.cpp next to
+// segment_color_patches_t's.
+template<class Palette>
+bool prefilter_may_contain_marker_t(const cv::Mat& bgr, const SegmentationParams& params, float coverage_thresh);
+
+template<class Palette>
+bool prefilter_may_contain_marker_yuv_t(const YuvPlanes& frame, const SegmentationParams& params, float coverage_thresh);
@@ -0,0 +1,63 @@
+#pragma once
+#include "pipeline.hpp"
+#include "mapped_file.hpp"
+#include <cstdint>
+#include <string>
+#include <deque>
+#include <unordered_map>
+
+// Fixed-size on-disk record: everything needed to re-emit an ImageResult.
+struct CacheRecord {
+    uint64_t content_hash;   // hash64 of the encoded file bytes
+    uint64_t params_hash;    // cache_params_hash() at the time of the run
+    double   image_area;
+    uint8_t  ok;
+    uint8_t  fr;             // FailureReason
+    uint8_t  n_markers;      // <= kMaxMarkers
+    uint8_t  pad[5];
+    float    cvx, cvy;       // primary marker spacing stats
+    float    ratio[4];       // per-marker hull / image
+    float    hull_area[4];
+};
+
+// ImageResult <-> record (hashes left 0), shared with the run journal. Keeps
+// what report_image needs: decision, reason, per-marker coverage.
+CacheRecord make_cache_record(const ImageResult& res);
+ImageResult result_from_record(const CacheRecord& r);
+// false: the record would drop markers (--multi found more than kMaxMarkers).
+// Such results are neither cached nor journaled, so a warm run reports what a
+// cold one does.
+bool cache_record_fits(const ImageResult& res);
+
+// Hash of every parameter that affects the result (debug flags excluded).
+// Entries written under other parameters never match -> implicit invalidation.
+uint64_t cache_params_hash(const SegmentationParams& segp, const GridParams& gp, bool multi);
+
+// Append-only result cache. The file is memory-mapped at open() and the index
+// points straight into the mapped records; new results are buffered and
+// appended on flush().
+// Layout: 16-byte header ("MKCACHE" + version + record size) then records.
+// A record holds at most kMaxMarkers markers; store() skips larger results.
+class ResultCache {
+public:
+    static constexpr int kMaxMarkers = 4;
+
+    ~ResultCache() { flush(); }
+
+    bool open(const std::string& path, uint64_t params_hash);
+    bool lookup(uint64_t content_hash, ImageResult& out) const;
+    bool contains(uint64_t content_hash) const { return index_.count(content_hash) != 0; }
+    void store(uint64_t content_hash, const ImageResult& res);
+    bool flush();
+
+    size_t hits() const { return hits_; }
+
+private:
+    std::string path_;
+    uint64_t params_hash_ = 0;
+    MappedFile map_;
+    std::unordered_map<uint64_t, const CacheRecord*> index_;
+    std::deque<CacheRecord> added_;   // stable addresses for index_
+    size_t flushed_ = 0;              // added_[0, flushed_) already on disk
+    mutable size_t hits_ = 0;
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include "pipeline.hpp"
+#include "result_cache.hpp"
+#include "mapped_file.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+// One completed input as recorded in the journal.
+struct JournalEntry {
+    ImageResult res;        // as result_from_record() rebuilds it
+    double ms = 0.0;
+    size_t peak_bytes = 0;
+};
+
+// Append-only log of completed inputs (main --journal), so a killed batch run
+// resumes where it stopped. Each record holds the input name, a stamp of the
+// input's content, a CacheRecord and the timing columns, plus a checksum. An
+// entry is replayed only while the stamp matches: a file rewritten under the
+// same name runs again. Records are flushed to the kernel
+// as they are written, so a killed process loses nothing. They are fsync'ed
+// every kJournalSyncRecords records or kJournalSyncSeconds, whichever comes
+// first, which bounds what a machine crash can lose.
+// At open the existing file is mapped and indexed by a hash of the name. A
+// torn or corrupt tail is cut off. A journal written under other parameters
+// is refused rather than mixed.
+// Stamp of a file for the journal: its size and mtime mixed, 0 when it cannot
+// be stat'ed. Pack entries use their stored content hash instead.
+uint64_t input_stamp(const std::string& path);
+
+constexpr int    kJournalSyncRecords = 256;
+constexpr double kJournalSyncSeconds = 2.0;
+
+class RunJournal {
+public:
+    RunJournal() = default;
+    ~RunJournal() { close(); }
+    RunJournal(const RunJournal&) = delete;
+    RunJournal& operator=(const RunJournal&) = delete;
+
+    // Creates the file if missing. false: I/O error, or params_mismatch set.
+    bool open(const std::string& path, uint64_t params_hash, bool& params_mismatch);
+    void close();                                   // syncs
+
+    // Latest record for name, if it was written with this stamp.
+    bool contains(const std::string& name, uint64_t stamp) const { return find(name, stamp) != kNone; }
+    bool lookup(const std::string& name, uint64_t stamp, JournalEntry& out) const;
+    bool append(const std::string& name, uint64_t stamp, const ImageResult& res, double ms, size_t peak_bytes);
+    bool sync();
+
+    size_t loaded() const { return index_.size(); } // distinct inputs found at open
+
+private:
+    static constexpr size_t kNone = ~size_t(0);
+    size_t find(const std::string& name, uint64_t stamp) const;   // record offset or kNone
+
+    MappedFile map_;                                // records present at open
+    std::unordered_map<uint64_t, size_t> index_;    // name hash -> record offset in map_
+    std::FILE* f_ = nullptr;
+    int unsynced_ = 0;
+    std::chrono::steady_clock::time_point last_sync_;
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Streaming 8-connected component labeling over run-length encoded rows.
+// Rows are pushed top to bottom; only the previous row's runs and the
+// currently open blobs are kept, so memory is O(width + open blobs) no
+// matter how tall the image is. A blob is reported as soon as a row no
+// longer touches it.
+class RunLabeler {
+public:
+    struct Blob {
+        int64_t count = 0;                 // pixels
+        int minx = 0, miny = 0, maxx = 0, maxy = 0;
+        double sx = 0.0, sy = 0.0;         // coordinate sums (centroid = s / count)
+    };
+
+    // mask: one row, non-zero = foreground.
+    void push_row(const unsigned char* mask, int width, int y);
+    // Closes every open blob (call after the last row).
+    void finish();
+
+    // Completed blobs since the last take(); the caller owns them afterwards.
+    std::vector<Blob> take() { std::vector<Blob> out; out.swap(done_); return out; }
+    size_t open_blobs() const { return blobs_.size() - free_.size(); }
+
+private:
+    struct Run { int x0, x1, label; };
+    struct Node { Blob b; int parent; int seen; bool open; };
+
+    int  find(int i);
+    int  alloc(int y);
+    void unite(int a, int b);
+    void close_blob(int root);
+
+    std::vector<Node> blobs_;
+    std::vector<int> free_, merged_;
+    std::vector<Run> prev_, cur_;
+    std::vector<Blob> done_;
+};
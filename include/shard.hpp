@@ -0,0 +1,37 @@
+#pragma once
+#include "pipeline.hpp"
+#include <ostream>
+#include <string>
+#include <vector>
+
+// --shard i/N: deterministic subset of the input stream. An input belongs to
+// shard hash64(path) % N, so every host given the same list picks disjoint
+// subsets that together cover it, independent of list order.
+struct ShardSpec {
+    int index = 0;
+    int count = 1;
+};
+
+bool parse_shard(const std::string& s, ShardSpec& out); // "i/N", 0 <= i < N
+bool shard_selects(const ShardSpec& spec, const std::string& path);
+
+// One line of a structured results file (--results), tab separated:
+//   path  ok(0/1)  percent  reason  ms  peak_kb
+// (v1 files without peak_kb are still read; their peak reads 0)
+struct ResultRow {
+    std::string path;
+    bool ok = false;
+    int pct = 0;
+    std::string reason;
+    double ms = 0.0;
+    size_t peak_kb = 0;    // peak tracked memory for the image (mem_stats.hpp)
+};
+
+ResultRow make_result_row(const std::string& path, const ImageResult& res, double ms, size_t peak_bytes = 0);
+void write_results_header(std::ostream& os);
+void write_result_row(std::ostream& os, const ResultRow& row);
+bool read_result_rows(const std::string& file, std::vector<ResultRow>& out);
+
+// --merge: combines per-shard results files into one report ordered by path,
+// with global pass/fail counts, latency and peak-memory percentiles. Returns the exit code.
+int merge_results(const std::vector<std::string>& files, std::ostream& os);
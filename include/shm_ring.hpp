@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Single-producer / single-consumer ring of fixed-size slots in POSIX shared
+// memory (shm_open + mmap), for frames coming from a separate capture process.
+// head/tail are lock-free 64-bit counters on their own cache lines; a slot
+// stays owned by the consumer from begin_read() until end_read(), so detection
+// can run on the shared pages directly (zero-copy cv::Mat header) and the
+// producer never overwrites a frame in use. Full ring -> try_write() fails and
+// the producer decides (drop or wait). Not available on Windows (open fails).
+class ShmRing {
+public:
+    // Frame geometry travels in the header so the consumer needs no config.
+    struct Layout {
+        uint32_t slots = 8;
+        uint32_t payload_bytes = 0;
+        int32_t width = 0, height = 0, type = 0;   // cv::Mat type; 0×0 for non-image rings
+        uint32_t step = 0;
+        uint32_t yuv = 0;   // YuvFormat (yuv_frame.hpp): 4:2:0 frames of H*3/2 CV_8UC1 rows
+        uint32_t reserved = 0;
+    };
+
+    // Per-slot metadata, written by the producer before commit.
+    struct SlotMeta {
+        uint64_t seq;                // producer's running frame number
+        uint64_t timestamp_ns;       // producer clock, passed through to results
+    };
+
+    ShmRing() = default;
+    ~ShmRing() { close(); }
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    bool create(const std::string& name, const Layout& layout);  // owner; replaces a stale ring
+    bool attach(const std::string& name);                        // peer; waits for nothing
+    void close();
+    void unlink();                                               // owner: remove the name
+
+    bool is_open() const { return hdr_ != nullptr; }
+    Layout layout() const;
+
+    // Producer side. try_write returns nullptr when the ring is full.
+    unsigned char* try_write(SlotMeta*& meta);
+    void commit_write();
+    void count_drop();
+
+    // Consumer side. try_read returns nullptr when the ring is empty.
+    unsigned char* try_read(SlotMeta& meta);
+    void end_read();
+
+    // Producer signals end of stream; the consumer drains and stops.
+    void mark_closed();
+    bool closed() const;
+    uint64_t dropped() const;
+    uint64_t written() const;
+
+private:
+    struct Header;
+    Header* hdr_ = nullptr;
+    unsigned char* slots_ = nullptr;
+    size_t map_size_ = 0;
+    std::string name_;
+};
+
+// One detection outcome in the companion results ring ("<name>.results").
+struct ShmResult {
+    uint64_t frame_seq;
+    uint64_t timestamp_ns;          // copied from the frame's SlotMeta
+    uint8_t  ok;
+    uint8_t  reason;                // FailureReason
+    uint8_t  n_markers;             // accepted markers (pct[] holds up to 4)
+    uint8_t  pad[5];
+    float    pct[4];
+    float    ms;                    // detection latency
+    float    pad2;
+};
+static_assert(sizeof(ShmResult) == 48, "ShmResult is shared across processes");
+
+inline std::string shm_results_name(const std::string& frames) { return frames + ".results"; }
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+
+// Optional per-stage instrumentation (main --perf). Each StageTimer scope adds
+// wall time and, on Linux when perf_event_open is permitted, hardware counters
+// (cycles, instructions, cache misses, branch misses) of the calling thread.
+// The same scopes feed the --metrics stage histograms (metrics.hpp).
+// Disabled -> a StageTimer costs one branch plus the always-on peak-memory
+// attribution (mem_stats.hpp), a few integer updates.
+enum class Stage { HsvLabel = 0, Morphology, Contours, PcaKmeans, Assignment, Hull, Count };
+
+const char* stage_name(Stage s);
+
+// Also limits OpenCV to one thread (cv::setNumThreads(1)) so the per-thread
+// counters see all of a stage's work; the report says so.
+// Returns true if hardware counters are available; false = timing only.
+bool stage_profiler_enable();
+bool stage_profiler_enabled();
+
+// Pixels fed into the pipeline, for the per-megapixel averages.
+void stage_profiler_add_pixels(size_t pixels);
+
+void stage_profiler_report(std::ostream& os);
+
+class StageTimer {
+public:
+    explicit StageTimer(Stage s);
+    ~StageTimer();
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+private:
+    Stage stage_;
+    bool on_;
+    bool metrics_;
+    size_t mem_saved_;
+    long long t0_ns_ = 0;
+    unsigned long long c0_[4] = {0, 0, 0, 0};
+};
@@ -0,0 +1,20 @@
+#pragma once
+#include "types.hpp"
+#include "color_segmentation.hpp"
+#include "deadline.hpp"
+#include "strip_source.hpp"
+#include <vector>
+
+// Bounded-memory variant of segment_color_patches for images too large to
+// decode whole. Rows are pulled from src strip_rows at a time and classified
+// with kMaskHaloRows rows of context on each side, so the masks match the
+// whole-image ones; each color mask is then labeled by a streaming RunLabeler.
+// Working memory is O((strip_rows + 2*halo) × width) instead of O(image).
+//
+// Patches use pixel statistics instead of contours: box = pixel bounding box,
+// center = pixel centroid, area = pixel count (slightly above contourArea,
+// which runs through boundary pixel centers, and hole pixels are not counted).
+std::vector<Patch> segment_color_patches_strips(StripSource& src,
+                                                const SegmentationParams& params,
+                                                int strip_rows,
+                                                const Deadline* dl = nullptr);
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+// Row-sequential image decoder for bounded-memory (strip) processing.
+// Rows come out top to bottom as packed BGR, 3 bytes per pixel.
+class StripSource {
+public:
+    virtual ~StripSource() = default;
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    // false when the whole image had to be decoded up front (no strip decoder)
+    virtual bool streaming() const { return true; }
+
+    // Decodes up to max_rows further rows into dst (row stride `stride` bytes).
+    // Returns the number of rows written; 0 at the end or on a decode error.
+    virtual int read_rows(unsigned char* dst, size_t stride, int max_rows) = 0;
+
+    // Decodes the whole image into one Mat, for callers that end up needing it
+    // whole after all. Use instead of read_rows, not after it. Shorter than
+    // height() on a truncated input.
+    virtual cv::Mat read_all();
+
+protected:
+    int width_ = 0, height_ = 0;
+};
+
+// Picks a streaming decoder by file signature (PNG / JPEG / TIFF, when built
+// with MARKER_HAVE_PNG / _JPEG / _TIFF). Anything else - or interlaced PNG,
+// progressive-incompatible or tiled inputs, or a JPEG with an EXIF rotation -
+// falls back to a full decode wrapped as a StripSource (streaming() == false).
+// nullptr if unreadable.
+std::unique_ptr<StripSource> open_strip_source(const std::string& path);
+
+// View of an already decoded image (no copy), e.g. to segment it in strips.
+std::unique_ptr<StripSource> strip_source_from_mat(const cv::Mat& bgr);
@@ -17,8 +17,13 @@ enum class FailureReason {
     SPACING = 3,
     SMALL_HULL = 4,
     BAD_BBOX = 5,
-    LOW_COVERAGE = 6
+    LOW_COVERAGE = 6,
+    TIMEOUT = 7,
+    FEW_COLORS = 8,
+    FEW_COMPATIBLE = 9,
+    SMALL_SPREAD = 10
 };
+constexpr int kFailureReasonCount = 11;  // NONE .. SMALL_SPREAD, for per-reason tables
 
 inline const char* fr_to_cstr(FailureReason fr) {
     switch (fr) {
@@ -29,6 +34,10 @@ inline const char* fr_to_cstr(FailureReason fr) {
     case FailureReason::SMALL_HULL:   return "HULL_TOO_SMALL";
     case FailureReason::BAD_BBOX:     return "INVALID_BBOX";
     case FailureReason::LOW_COVERAGE: return "LOW_COVERAGE";
+    case FailureReason::TIMEOUT:      return "TIMEOUT";
+    case FailureReason::FEW_COLORS:   return "TOO_FEW_COLORS";
+    case FailureReason::FEW_COMPATIBLE: return "TOO_FEW_COMPATIBLE_PATCHES";
+    case FailureReason::SMALL_SPREAD: return "SPREAD_TOO_SMALL";
     default:                          return "UNKNOWN";
     }
 }
@@ -0,0 +1,107 @@
+#pragma once
+#include "palette.hpp"
+#include "yuv_frame.hpp"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Palette classification straight from 4:2:0 YUV (NV12/I420 frames), without
+// a BGR or HSV image. The palette's HSV bands are baked into a table indexed
+// by quantized (U, V, Y): 128×128 chroma cells × 32 luma levels, 512 KB. Each
+// entry holds the classify_hsv<P>() bits of its cell center, converted to BGR
+// the way cv::COLOR_YUV2BGR_NV12 does (BT.601, video range) and then to HSV.
+// A chroma value's 32 luma entries are contiguous. Chroma values whose row is
+// all zero (gray and unsaturated areas, most of a frame) skip the luma lookup.
+constexpr int kYuvLutYBits = 5, kYuvLutUvBits = 7;
+
+struct YuvLut {
+    static constexpr int kY = 1 << kYuvLutYBits, kUv = 1 << kYuvLutUvBits;
+    std::vector<uint8_t> bits;  // [u][v][y] -> palette bits
+    std::vector<uint8_t> any;   // [u][v]    -> OR over y
+
+    const uint8_t* row(unsigned u, unsigned v) const {
+        return bits.data() + ((size_t)(u >> (8 - kYuvLutUvBits)) * kUv + (v >> (8 - kYuvLutUvBits))) * kY;
+    }
+    bool empty(unsigned u, unsigned v) const {
+        return !any[(u >> (8 - kYuvLutUvBits)) * kUv + (v >> (8 - kYuvLutUvBits))];
+    }
+    static unsigned y_index(unsigned y) { return y >> (8 - kYuvLutYBits); }
+    unsigned classify(unsigned y, unsigned u, unsigned v) const { return row(u, v)[y_index(y)]; }
+};
+
+// BT.601 video range, the fixed-point coefficients of OpenCV's YUV420 -> BGR,
+// on doubled inputs so that a cell center between two codes is exact.
+inline cv::Vec3b yuv2_to_bgr_bt601(int y2, int u2, int v2) {
+    const int yy = std::max(0, y2 - 32) * 1220542;
+    u2 -= 256; v2 -= 256;
+    auto sat = [](int x) { return (unsigned char)std::min(255, std::max(0, (x + (1 << 20)) >> 21)); };
+    return cv::Vec3b(sat(yy + 2116026 * u2), sat(yy - 852492 * v2 - 409993 * u2), sat(yy + 1673527 * v2));
+}
+
+template<class P>
+YuvLut build_yuv_lut() {
+    YuvLut lut;
+    const int n = YuvLut::kUv * YuvLut::kUv * YuvLut::kY;
+    const int uv_step = 1 << (8 - kYuvLutUvBits), y_step = 1 << (8 - kYuvLutYBits);
+    cv::Mat bgr(1, n, CV_8UC3), hsv;
+    int i = 0;
+    for (int u = 0; u < YuvLut::kUv; ++u)
+        for (int v = 0; v < YuvLut::kUv; ++v)
+            for (int y = 0; y < YuvLut::kY; ++y)
+                bgr.at<cv::Vec3b>(0, i++) = yuv2_to_bgr_bt601(2 * y * y_step + y_step - 1, 2 * u * uv_step + uv_step - 1,
+                                                              2 * v * uv_step + uv_step - 1);
+    cv::cvtColor(bgr, hsv, cv::COLOR_BGR2HSV);   // the exact 8-bit HSV the BGR path sees
+    lut.bits.resize(n);
+    lut.any.assign((size_t)YuvLut::kUv * YuvLut::kUv, 0);
+    const unsigned char* p = hsv.ptr<unsigned char>(0);
+    for (i = 0; i < n; ++i, p += 3) {
+        lut.bits[i] = (uint8_t)classify_hsv<P>(p[0], p[1], p[2]);
+        lut.any[i / YuvLut::kY] |= lut.bits[i];
+    }
+    return lut;
+}
+
+// Built on first use, once per palette.
+template<class P>
+const YuvLut& yuv_lut() {
+    static const YuvLut lut = build_yuv_lut<P>();
+    return lut;
+}
+
+// The planes the table is applied to, all CV_8UC1 of the luma size and
+// preallocated: luma with the 3×3 Gaussian the BGR path applies to its HSV
+// image, chroma interpolated to full resolution (bilinear, 3:1 weights). On
+// chroma replicated per 2×2 block, as cv::COLOR_YUV2BGR_* does, that blur
+// gives these same weights, so patch edges land where the BGR path puts them.
+inline void smooth_yuv_planes(const YuvPlanes& f, cv::Mat& y, cv::Mat& u, cv::Mat& v) {
+    cv::GaussianBlur(f.y, y, cv::Size(3, 3), 0);
+    if (f.format == YuvFormat::NV12) {
+        cv::Mat half[2];
+        cv::split(f.uv, half);
+        cv::resize(half[0], u, f.size(), 0, 0, cv::INTER_LINEAR);
+        cv::resize(half[1], v, f.size(), 0, 0, cv::INTER_LINEAR);
+    }
+    else {
+        cv::resize(f.u, u, f.size(), 0, 0, cv::INTER_LINEAR);
+        cv::resize(f.v, v, f.size(), 0, 0, cv::INTER_LINEAR);
+    }
+}
+
+// Every color mask (0/255) from smooth_yuv_planes() output. Masks must be
+// preallocated CV_8UC1 of the luma size.
+template<class P>
+inline void classify_masks_yuv(const cv::Mat& y, const cv::Mat& u, const cv::Mat& v, cv::Mat (&masks)[P::kColors]) {
+    const YuvLut& lut = yuv_lut<P>();
+    for (int r = 0; r < y.rows; ++r) {
+        const unsigned char* py = y.ptr<unsigned char>(r);
+        const unsigned char* pu = u.ptr<unsigned char>(r);
+        const unsigned char* pv = v.ptr<unsigned char>(r);
+        unsigned char* out[P::kColors];
+        for (int k = 0; k < P::kColors; ++k) out[k] = masks[k].template ptr<unsigned char>(r);
+        for (int x = 0; x < y.cols; ++x) {
+            const unsigned bits = lut.empty(pu[x], pv[x]) ? 0u : lut.classify(py[x], pu[x], pv[x]);
+            for (int k = 0; k < P::kColors; ++k) out[k][x] = (unsigned char)(0u - ((bits >> k) & 1u));
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <string>
+
+// 4:2:0 frames as cameras and hardware decoders deliver them. In OpenCV's
+// convention such a frame is one CV_8UC1 Mat of H*3/2 rows × W: the luma
+// plane, then NV12's interleaved U/V rows or I420's U plane and V plane, each
+// chroma row half the luma step.
+enum class YuvFormat : uint32_t { None = 0, NV12 = 1, I420 = 2 };
+
+// Views into a frame's planes (no copy). Chroma is W/2 × H/2: uv (CV_8UC2,
+// U first) for NV12, u and v (CV_8UC1) for I420.
+struct YuvPlanes {
+    YuvFormat format = YuvFormat::None;
+    cv::Mat y;
+    cv::Mat uv;
+    cv::Mat u, v;
+
+    int width() const { return y.cols; }
+    int height() const { return y.rows; }
+    cv::Size size() const { return y.size(); }
+};
+
+// false: not CV_8UC1, or the frame size is not even in both directions.
+bool yuv_planes(const cv::Mat& yuv, YuvFormat format, YuvPlanes& out);
+
+// BGR (even size) -> frame in the given format, video range BT.601 as
+// cv::COLOR_BGR2YUV_I420 produces it.
+void bgr_to_yuv(const cv::Mat& bgr, YuvFormat format, cv::Mat& yuv);
+// Back to BGR (overlays, comparisons).
+void yuv_to_bgr(const cv::Mat& yuv, YuvFormat format, cv::Mat& bgr);
+
+bool parse_yuv_format(const std::string& s, YuvFormat& out);   // "nv12" / "i420"
+const char* yuv_format_name(YuvFormat f);
@@ -0,0 +1,85 @@
+#include "alloc_stats.hpp"
+#include "mem_stats.hpp"
+
+#ifdef MARKER_COUNT_ALLOCS
+#include <opencv2/opencv.hpp>
+#include <cstdlib>
+#include <new>
+
+static thread_local AllocStats t_stats;
+
+static inline void count_alloc(size_t n) { ++t_stats.count; t_stats.bytes += n; }
+
+AllocStats alloc_stats_thread() { return t_stats; }
+
+// Counts (and tracks live bytes for mem_stats), then defers to OpenCV's
+// standard allocator (which also frees).
+class CountingMatAllocator : public cv::MatAllocator {
+public:
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usage) const override {
+        cv::UMatData* u = base()->allocate(dims, sizes, type, data, step, flags, usage);
+        if (u && !data) { count_alloc(u->size); mem_track_alloc(u->size); }
+        return u;
+    }
+    bool allocate(cv::UMatData* u, cv::AccessFlag flags, cv::UMatUsageFlags usage) const override {
+        return base()->allocate(u, flags, usage);
+    }
+    void deallocate(cv::UMatData* u) const override {
+        if (u && !(u->flags & cv::UMatData::USER_ALLOCATED)) mem_track_free(u->size);
+        base()->deallocate(u);
+    }
+private:
+    static cv::MatAllocator* base() { return cv::Mat::getStdAllocator(); }
+};
+
+void alloc_stats_install() {
+    static CountingMatAllocator counting;
+    cv::Mat::setDefaultAllocator(&counting);
+}
+
+// --- global operator new/delete replacement ---------------------------------
+static void* counted_malloc(size_t n) {
+    count_alloc(n);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+static void* counted_aligned(size_t n, size_t al) {
+    count_alloc(n);
+#ifdef _WIN32
+    if (void* p = _aligned_malloc(n ? n : 1, al)) return p;
+#else
+    void* p = nullptr;
+    if (posix_memalign(&p, al < sizeof(void*) ? sizeof(void*) : al, n ? n : 1) == 0) return p;
+#endif
+    throw std::bad_alloc();
+}
+static void aligned_free(void* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void* operator new(size_t n) { return counted_malloc(n); }
+void* operator new[](size_t n) { return counted_malloc(n); }
+void* operator new(size_t n, const std::nothrow_t&) noexcept { try { return counted_malloc(n); } catch (...) { return nullptr; } }
+void* operator new[](size_t n, const std::nothrow_t&) noexcept { try { return counted_malloc(n); } catch (...) { return nullptr; } }
+void* operator new(size_t n, std::align_val_t al) { return counted_aligned(n, (size_t)al); }
+void* operator new[](size_t n, std::align_val_t al) { return counted_aligned(n, (size_t)al); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { aligned_free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { aligned_free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { aligned_free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { aligned_free(p); }
+
+#else
+
+AllocStats alloc_stats_thread() { return AllocStats(); }
+void alloc_stats_install() {}
+
+#endif
@@ -1,55 +1,274 @@
 #include "color_segmentation.hpp"
+#include "palette.hpp"
+#include "mask_ops.hpp"
+#include "yuv_classify.hpp"
+#include "frame_arena.hpp"
+#include "stage_profiler.hpp"
+#include "mem_stats.hpp"
+#include "frame_batch.hpp"
 using namespace cv;
 using std::vector; using std::string;
 
-static Mat inRangeHSV(const Mat& hsv, Scalar low, Scalar high) {
-    Mat mask; inRange(hsv, low, high, mask); return mask;
+// Outer contours of one cleaned mask -> patches of the given color within the
+// area bounds (image pixels). ids continue from next_id.
+static void trace_patches(const Mat& mask, const char* label, double min_area, double max_area,
+                          MemCharge& contour_mem, int& next_id, vector<Patch>& patches) {
+    // findContours only fills std::vector outputs; keep them per thread so their
+    // capacity is reused from image to image instead of reallocated.
+    thread_local vector<vector<Point>> contours;
+    thread_local vector<Vec4i> hier;
+    // OpenCV >= 3.2 leaves the source untouched, so no copy of the mask.
+    findContours(mask, contours, hier, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+    size_t contour_bytes = contours.capacity() * sizeof(vector<Point>) + hier.capacity() * sizeof(Vec4i);
+    for (const auto& cnt : contours) contour_bytes += cnt.capacity() * sizeof(Point);
+    contour_mem.set(contour_bytes);
+    for (const auto& cnt : contours) {
+        double a = contourArea(cnt); if (a < min_area || a > max_area) continue;
+        Rect box = boundingRect(cnt);
+        Moments m = moments(cnt); if (m.m00 <= 0) continue;
+        Point2f center((float)(m.m10/m.m00), (float)(m.m01/m.m00));
+        patches.push_back(Patch{label, box, center, a, next_id++});
+    }
 }
-static void cleanMask(Mat& mask) {
-    Mat k = getStructuringElement(MORPH_ELLIPSE, {3,3});
-    morphologyEx(mask, mask, MORPH_OPEN, k);
-    morphologyEx(mask, mask, MORPH_CLOSE, k);
+
+// Whole-image masks of every color -> cleaned -> patches within the area bounds.
+template<class P>
+static vector<Patch> clean_and_trace(Mat (&masks)[P::kColors], double min_area, double max_area,
+                                     const Deadline* dl) {
+    {
+        StageTimer st(Stage::Morphology);
+        for (Mat& m : masks) {
+            clean_mask(m);
+            if (dl && dl->expired()) return {};
+        }
+    }
+
+    vector<Patch> patches;
+    MemCharge contour_mem;
+    int next_id = 0;
+    StageTimer st(Stage::Contours);
+    for (int ci = 0; ci < P::kColors; ++ci) {
+        if (dl && dl->expired()) break;
+        trace_patches(masks[ci], P::names[ci], min_area, max_area, contour_mem, next_id, patches);
+    }
+    return patches;
 }
 
-std::vector<Patch> segment_color_patches(const cv::Mat& bgr, const SegmentationParams& params) {
+// area_scale widens the area bounds (1 = as configured); hsv_out (optional)
+// receives the blurred HSV image, valid while an enclosing ArenaScope lives.
+template<class P>
+static vector<Patch> segment_bgr(const Mat& bgr, const SegmentationParams& params, const Deadline* dl,
+                                 double area_scale, Mat* hsv_out) {
     CV_Assert(!bgr.empty());
-    Mat hsv; cvtColor(bgr, hsv, COLOR_BGR2HSV);
-    GaussianBlur(hsv, hsv, Size(3,3), 0);
+    ArenaScope scope;   // all image-sized temporaries live in the thread's arena
+    FrameArena& arena = scope.arena();
 
-    Mat red1 = inRangeHSV(hsv, { 0,   80, 60 }, { 10, 255, 255 });
-    Mat red2 = inRangeHSV(hsv, {170,  80, 60 }, {180, 255, 255 });
-    Mat red; bitwise_or(red1, red2, red);
-    Mat green   = inRangeHSV(hsv, { 35, 60, 60 }, { 85, 255, 255 });
-    Mat blue    = inRangeHSV(hsv, { 90, 60, 60 }, {130, 255, 255 });
-    Mat yellow  = inRangeHSV(hsv, { 20, 60, 60 }, { 35, 255, 255 });
-    Mat cyan    = inRangeHSV(hsv, { 80, 60, 60 }, { 95, 255, 255 });
-    Mat magenta = inRangeHSV(hsv, {140, 60, 60 }, {170, 255, 255 });
+    // Under a memory budget that cannot hold every mask at once, keep a single
+    // mask and run classify -> clean -> trace one color at a time.
+    const bool per_color = params.mem_budget > 0 &&
+        plan_memory(bgr.size(), params.mem_budget).strategy != MemStrategy::Full;
+    const int n_masks = per_color ? 1 : P::kColors;
+
+    Mat hsv = arena.mat(bgr.rows, bgr.cols, CV_8UC3);
+    Mat masks[P::kColors];
+    {
+        StageTimer st(Stage::HsvLabel);
+        cvtColor(bgr, hsv, COLOR_BGR2HSV);
+        GaussianBlur(hsv, hsv, Size(3,3), 0);
+        if (hsv_out) *hsv_out = hsv;
+        if (dl && dl->expired()) return {};
+
+        for (int i = 0; i < n_masks; ++i) masks[i] = arena.mat(bgr.rows, bgr.cols, CV_8UC1);
+        if (!per_color) classify_masks<P>(hsv, masks);
+    }
 
-    for (Mat* m : { &red,&green,&blue,&yellow,&cyan,&magenta }) cleanMask(*m);
+    if (dl && dl->expired()) return {};
+    if (!per_color) {
+        StageTimer st(Stage::Morphology);
+        for (Mat& m : masks) {
+            clean_mask(m);
+            if (dl && dl->expired()) return {};
+        }
+    }
 
     vector<Patch> patches;
     const double img_area = (double)bgr.cols * (double)bgr.rows;
-    const double min_area = params.min_area_ratio * img_area;
-    const double max_area = params.max_area_ratio * img_area;
+    const double min_area = params.min_area_ratio / area_scale * img_area;
+    const double max_area = params.max_area_ratio * area_scale * img_area;
 
-    vector<std::pair<string,Mat>> masks = {
-        {"red", red}, {"green",green}, {"blue",blue},
-        {"yellow",yellow},{"cyan",cyan},{"magenta",magenta}
-    };
+    MemCharge contour_mem;
 
     int next_id = 0;
-    for (auto& lm : masks) {
-        const string& label = lm.first;
-        Mat mask = lm.second.clone();
-        vector<vector<Point>> contours; vector<Vec4i> hier;
-        findContours(mask, contours, hier, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
-        for (const auto& cnt : contours) {
-            double a = contourArea(cnt); if (a < min_area || a > max_area) continue;
-            Rect box = boundingRect(cnt);
-            Moments m = moments(cnt); if (m.m00 <= 0) continue;
-            Point2f center((float)(m.m10/m.m00), (float)(m.m01/m.m00));
-            patches.push_back(Patch{label, box, center, a, next_id++});
+    for (int ci = 0; ci < P::kColors; ++ci) {
+        if (dl && dl->expired()) break;
+        Mat& mask = masks[per_color ? 0 : ci];
+        if (per_color) {
+            { StageTimer st(Stage::HsvLabel);   classify_mask<P>(hsv, ci, mask); }
+            { StageTimer st(Stage::Morphology); clean_mask(mask); }
         }
+
+        StageTimer st(Stage::Contours);
+        const char* label = P::names[ci];
+        trace_patches(mask, label, min_area, max_area, contour_mem, next_id, patches);
     }
     return patches;
 }
+
+template<class P>
+std::vector<Patch> segment_color_patches_t(const cv::Mat& bgr, const SegmentationParams& params,
+                                           const Deadline* dl) {
+    return segment_bgr<P>(bgr, params, dl, 1.0, nullptr);
+}
+
+template std::vector<Patch> segment_color_patches_t<SixColorPalette>(
+    const cv::Mat&, const SegmentationParams&, const Deadline*);
+
+void segment_color_patches_keep(const cv::Mat& bgr, const SegmentationParams& params, KeptPass& out,
+                                const Deadline* dl) {
+    const double scale = std::max(1.0, params.retry_area_scale);
+    out.patches = segment_bgr<DefaultPalette>(bgr, params, dl, scale, &out.hsv);
+}
+
+std::vector<Patch> filter_patches_by_area(const std::vector<Patch>& patches, const cv::Size& img_size,
+                                          double min_ratio, double max_ratio) {
+    const double img_area = (double)img_size.width * (double)img_size.height;
+    std::vector<Patch> out;
+    for (const Patch& p : patches) {
+        if (p.area < min_ratio * img_area || p.area > max_ratio * img_area) continue;
+        out.push_back(p);
+        out.back().id = (int)out.size() - 1;
+    }
+    return out;
+}
+
+std::vector<Patch> segment_widened(const KeptPass& pass, const SegmentationParams& params,
+                                   const Deadline* dl) {
+    using W = WidenedPalette<DefaultPalette, kRetryHueWiden, kRetrySatWiden, kRetryValWiden>;
+    ArenaScope scope;
+    FrameArena& arena = scope.arena();
+    Mat masks[W::kColors];
+    {
+        StageTimer st(Stage::HsvLabel);
+        for (Mat& m : masks) m = arena.mat(pass.hsv.rows, pass.hsv.cols, CV_8UC1);
+        classify_masks<W>(pass.hsv, masks);
+    }
+    if (dl && dl->expired()) return {};
+    const double img_area = (double)pass.hsv.cols * (double)pass.hsv.rows;
+    const double scale = std::max(1.0, params.retry_area_scale);
+    return clean_and_trace<W>(masks, params.min_area_ratio / scale * img_area,
+                              params.max_area_ratio * scale * img_area, dl);
+}
+
+std::vector<Patch> segment_color_patches(const cv::Mat& bgr, const SegmentationParams& params,
+                                         const Deadline* dl) {
+    return segment_color_patches_t<DefaultPalette>(bgr, params, dl);
+}
+
+template<class P>
+std::vector<Patch> segment_color_patches_yuv_t(const YuvPlanes& frame, const SegmentationParams& params,
+                                               const Deadline* dl) {
+    CV_Assert(!frame.y.empty());
+    ArenaScope scope;
+    FrameArena& arena = scope.arena();
+    const Size sz = frame.size();
+
+    Mat masks[P::kColors];
+    {
+        StageTimer st(Stage::HsvLabel);
+        Mat y = arena.mat(sz.height, sz.width, CV_8UC1);
+        Mat u = arena.mat(sz.height, sz.width, CV_8UC1);
+        Mat v = arena.mat(sz.height, sz.width, CV_8UC1);
+        smooth_yuv_planes(frame, y, u, v);
+        if (dl && dl->expired()) return {};
+        for (Mat& m : masks) m = arena.mat(sz.height, sz.width, CV_8UC1);
+        classify_masks_yuv<P>(y, u, v, masks);
+    }
+
+    if (dl && dl->expired()) return {};
+    const double img_area = (double)sz.width * (double)sz.height;
+    return clean_and_trace<P>(masks, params.min_area_ratio * img_area, params.max_area_ratio * img_area, dl);
+}
+
+template std::vector<Patch> segment_color_patches_yuv_t<SixColorPalette>(
+    const YuvPlanes&, const SegmentationParams&, const Deadline*);
+
+std::vector<Patch> segment_color_patches_yuv(const YuvPlanes& frame, const SegmentationParams& params,
+                                             const Deadline* dl) {
+    return segment_color_patches_yuv_t<DefaultPalette>(frame, params, dl);
+}
+
+template<class P>
+std::vector<std::vector<Patch>> segment_color_patches_batch_t(const FrameBatch& batch, const SegmentationParams& params,
+                                                              const std::vector<bool>& active) {
+    const int n = batch.size();
+    std::vector<std::vector<Patch>> out(n);
+    if (n == 0) return out;
+    ArenaScope scope;
+    FrameArena& arena = scope.arena();
+
+    const Size fs = batch.frame_size();
+    const Mat bgr = batch.packed();
+    const int rows = bgr.rows;
+    // Every color's mask of the whole batch in one buffer, color c at rows
+    // [c*rows, (c+1)*rows): each morphology pass is then a single call.
+    Mat hsv = arena.mat(rows, fs.width, CV_8UC3);
+    Mat all = arena.mat(rows * P::kColors, fs.width, CV_8UC1);
+    Mat masks[P::kColors];
+    for (int c = 0; c < P::kColors; ++c) masks[c] = all.rowRange(c * rows, (c + 1) * rows);
+    {
+        StageTimer st(Stage::HsvLabel);
+        cvtColor(bgr, hsv, COLOR_BGR2HSV);
+        // The gap rows next to a frame mirror it as BORDER_REFLECT_101 would,
+        // so the blur of each frame equals the blur of that frame alone.
+        for (int i = 0; i < n; ++i) {
+            const int top = batch.frame_top(i), bottom = top + fs.height - 1;
+            hsv.row(top + 1).copyTo(hsv.row(top - 1));
+            hsv.row(bottom - 1).copyTo(hsv.row(bottom + 1));
+        }
+        GaussianBlur(hsv, hsv, Size(3,3), 0);
+        classify_masks<P>(hsv, masks);
+    }
+    {
+        StageTimer st(Stage::Morphology);
+        // clean_mask() as its four primitive passes, each over every color of
+        // every frame. Before a pass the gap rows take the value OpenCV assumes
+        // outside an image for it (erode 255, dilate 0), so no frame sees its
+        // neighbour and the result is the per-frame one.
+        static const Mat k = getStructuringElement(MORPH_ELLIPSE, {3,3});
+        auto pass = [&](bool erode_pass) {
+            const Scalar outside = Scalar::all(erode_pass ? 255 : 0);
+            for (int c = 0; c < P::kColors; ++c)
+                for (int i = 0; i <= n; ++i) {
+                    const int gap = c * rows + batch.frame_top(i) - kBatchGapRows;
+                    all.rowRange(gap, gap + kBatchGapRows).setTo(outside);
+                }
+            if (erode_pass) erode(all, all, k);
+            else            dilate(all, all, k);
+        };
+        pass(true);  pass(false);   // open
+        pass(false); pass(true);    // close
+    }
+
+    const double frame_area = (double)fs.width * (double)fs.height;
+    const double min_area = params.min_area_ratio * frame_area;
+    const double max_area = params.max_area_ratio * frame_area;
+    MemCharge contour_mem;
+    for (int i = 0; i < n; ++i) {
+        if (!active.empty() && !active[i]) continue;
+        StageTimer st(Stage::Contours);
+        const int top = batch.frame_top(i);
+        int next_id = 0;
+        for (int ci = 0; ci < P::kColors; ++ci)
+            trace_patches(masks[ci].rowRange(top, top + fs.height), P::names[ci],
+                          min_area, max_area, contour_mem, next_id, out[i]);
+    }
+    return out;
+}
+
+template std::vector<std::vector<Patch>> segment_color_patches_batch_t<SixColorPalette>(
+    const FrameBatch&, const SegmentationParams&, const std::vector<bool>&);
+
+std::vector<std::vector<Patch>> segment_color_patches_batch(const FrameBatch& batch, const SegmentationParams& params,
+                                                            const std::vector<bool>& active) {
+    return segment_color_patches_batch_t<DefaultPalette>(batch, params, active);
+}
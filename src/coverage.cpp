@@ -1,8 +1,10 @@
 #include "coverage.hpp"
+#include "stage_profiler.hpp"
 #include <cfloat>
 using namespace cv;
 
 CoverageResult compute_coverage_from_grid(const Patch grid[3][3], const cv::Size& img_size) {
+    StageTimer st(Stage::Hull);
     CoverageResult r;
     std::vector<Point2f> corners; corners.reserve(9 * 4);
     float minx = +FLT_MAX, miny = +FLT_MAX, maxx = -FLT_MAX, maxy = -FLT_MAX;
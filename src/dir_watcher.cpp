@@ -0,0 +1,74 @@
+#include "dir_watcher.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+std::vector<std::string> DirWatcher::list() const {
+    std::vector<std::string> out;
+    std::error_code ec;
+    for (const auto& e : std::filesystem::directory_iterator(dir_, ec)) {
+        const std::string name = e.path().filename().string();
+        if (name.empty() || name[0] == '.' || !e.is_regular_file(ec)) continue;
+        out.push_back(e.path().string());
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+#ifdef __linux__
+#include <cerrno>
+#include <climits>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+bool DirWatcher::open(const std::string& dir) {
+    close();
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0) return false;
+    wd_ = inotify_add_watch(fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+    if (wd_ < 0) { close(); return false; }
+    dir_ = dir;
+    return true;
+}
+
+void DirWatcher::close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = wd_ = -1;
+}
+
+bool DirWatcher::wait(std::vector<std::string>& out, int timeout_ms) {
+    if (fd_ < 0) return false;
+    pollfd pfd{fd_, POLLIN, 0};
+    const int r = poll(&pfd, 1, timeout_ms);
+    if (r < 0) return errno == EINTR;
+    if (r == 0) return true;
+
+    alignas(inotify_event) char buf[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+    for (;;) {
+        const ssize_t n = read(fd_, buf, sizeof(buf));
+        if (n <= 0) return n < 0 && (errno == EAGAIN || errno == EINTR);
+        for (ssize_t off = 0; off < n;) {
+            const inotify_event* ev = reinterpret_cast<const inotify_event*>(buf + off);
+            off += (ssize_t)(sizeof(inotify_event) + ev->len);
+            if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) return false;
+            if (ev->mask & IN_Q_OVERFLOW) {
+                std::cerr << "[watch] event queue overflow, rescanning " << dir_ << "\n";
+                const auto all = list();
+                out.insert(out.end(), all.begin(), all.end());
+                continue;
+            }
+            if ((ev->mask & IN_ISDIR) || ev->len == 0 || ev->name[0] == '.') continue;
+            out.push_back((std::filesystem::path(dir_) / ev->name).string());
+        }
+    }
+}
+
+#else
+
+bool DirWatcher::open(const std::string&) { return false; }
+void DirWatcher::close() {}
+bool DirWatcher::wait(std::vector<std::string>&, int) { return false; }
+
+#endif
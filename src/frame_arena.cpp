@@ -0,0 +1,49 @@
+#include "frame_arena.hpp"
+#include "mem_stats.hpp"
+#include <algorithm>
+
+static const size_t kInitialBlock = 1 << 20; // grows to the per-image high-water mark
+
+FrameArena& FrameArena::local() {
+    thread_local FrameArena arena;
+    return arena;
+}
+
+FrameArena::FrameArena() : block_(kInitialBlock) {
+    counting_.owner = this;
+    counting_.track(block_.size());
+    mono_.emplace(block_.data(), block_.size(), std::pmr::new_delete_resource());
+}
+
+// Resident arena memory: the first block always, plus upstream chunks once
+// an image overflows it.
+void FrameArena::Counting::track(size_t resident) {
+    if (resident > charged) mem_track_alloc(resident - charged);
+    else                    mem_track_free(charged - resident);
+    charged = resident;
+}
+
+void* FrameArena::Counting::do_allocate(size_t n, size_t align) {
+    ++allocs; bytes += n;
+    since_reset += n + align;
+    track(std::max(owner->block_.size(), since_reset));
+    return owner->mono_->allocate(n, align);
+}
+
+cv::Mat FrameArena::mat(int rows, int cols, int type) {
+    const size_t step = (size_t)cols * CV_ELEM_SIZE(type);
+    void* p = counting_.allocate(step * (size_t)rows, 64);
+    return cv::Mat(rows, cols, type, p, step);
+}
+
+void FrameArena::reset() {
+    mono_.reset();
+    size_t want = block_.size();
+    // overflowed into upstream chunks: make the first block big enough next time
+    if (counting_.since_reset > want) want = counting_.since_reset + counting_.since_reset / 4;
+    if (block_limit_ > 0) want = std::min(want, block_limit_);
+    if (want != block_.size()) std::vector<unsigned char>(want, 0).swap(block_);   // swap: assign keeps capacity
+    counting_.since_reset = 0;
+    counting_.track(block_.size());
+    mono_.emplace(block_.data(), block_.size(), std::pmr::new_delete_resource());
+}
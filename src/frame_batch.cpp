@@ -0,0 +1,21 @@
+#include "frame_batch.hpp"
+#include <algorithm>
+
+FrameBatch::FrameBatch(int capacity) : cap_(std::max(1, capacity)) {}
+
+bool FrameBatch::accepts(const cv::Mat& bgr) const {
+    if (bgr.type() != CV_8UC3 || bgr.rows < 2 || bgr.cols < 1 || full()) return false;
+    return n_ == 0 || bgr.size() == frame_;
+}
+
+bool FrameBatch::add(const cv::Mat& bgr) {
+    if (!accepts(bgr)) return false;
+    if (n_ == 0 && bgr.size() != frame_) {
+        frame_ = bgr.size();
+        buf_.create(frame_top(cap_), frame_.width, CV_8UC3);
+        buf_.setTo(cv::Scalar::all(0));   // gap rows are never written by add()
+    }
+    bgr.copyTo(buf_.rowRange(frame_top(n_), frame_top(n_) + frame_.height));
+    ++n_;
+    return true;
+}
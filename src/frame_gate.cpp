@@ -0,0 +1,24 @@
+#include "frame_gate.hpp"
+using namespace cv;
+
+bool FrameGate::unchanged(const cv::Mat& bgr) {
+    ++frames_;
+    if (p_.max_skip <= 0 || bgr.empty()) return false;
+
+    Mat small, sig;
+    resize(bgr, small, Size(p_.side, p_.side), 0, 0, INTER_AREA);
+    if (small.channels() == 3) cvtColor(small, sig, COLOR_BGR2GRAY);
+    else sig = small;
+
+    if (has_ref_ && since_ref_ < p_.max_skip) {
+        Mat diff; absdiff(sig, ref_, diff);
+        if (mean(diff)[0] < p_.threshold) {
+            ++since_ref_; ++skipped_;
+            return true;
+        }
+    }
+    ref_ = sig;
+    has_ref_ = true;
+    since_ref_ = 0;
+    return false;
+}
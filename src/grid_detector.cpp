@@ -1,72 +1,142 @@
 #include "grid_detector.hpp"
+#include "frame_arena.hpp"
+#include "stage_profiler.hpp"
+#include <optional>
 using namespace cv;
 using std::vector;
 
-static void pca_rotate(const std::vector<cv::Point2f>& pts,
+static void pca_rotate(const arena_vector<cv::Point2f>& pts,
                        std::vector<cv::Point2f>& rotated,
                        cv::Point2f& mean,
-                       cv::Mat& eigvecs) {
-    Mat data((int)pts.size(), 2, CV_32F);
+                       cv::Mat& eigvecs,
+                       FrameArena& arena) {
+    Mat data = arena.mat((int)pts.size(), 2, CV_32F);
     for (int i=0;i<(int)pts.size();++i){ data.at<float>(i,0)=pts[i].x; data.at<float>(i,1)=pts[i].y; }
     PCA pca(data, Mat(), PCA::DATA_AS_ROW);
-    eigvecs = pca.eigenvectors.clone();
+    eigvecs = arena.mat(2, 2, CV_32F);
+    pca.eigenvectors.copyTo(eigvecs);
     mean = Point2f(pca.mean.at<float>(0,0), pca.mean.at<float>(0,1));
+    // r = v * eigvecs^T, written out for 2x2 to avoid a Mat per point
+    const float e00=eigvecs.at<float>(0,0), e01=eigvecs.at<float>(0,1);
+    const float e10=eigvecs.at<float>(1,0), e11=eigvecs.at<float>(1,1);
     rotated.resize(pts.size());
     for (int i=0;i<(int)pts.size();++i) {
-        Vec2f v(pts[i].x-mean.x, pts[i].y-mean.y);
-        Mat vm = (Mat_<float>(1,2) << v[0], v[1]);
-        Mat r = vm * eigvecs.t();
-        rotated[i] = Point2f(r.at<float>(0,0), r.at<float>(0,1));
+        float vx = pts[i].x-mean.x, vy = pts[i].y-mean.y;
+        rotated[i] = Point2f(vx*e00 + vy*e01, vx*e10 + vy*e11);
     }
 }
 
-static float stdev(const std::vector<float>& v){
+static float stdev(const arena_vector<float>& v){
     if (v.size()<2) return 0.f;
     float m=0.f; for(float x:v) m+=x; m/= (float)v.size();
     float s2=0.f; for(float x:v) s2+=(x-m)*(x-m);
     return std::sqrt(s2/(float)(v.size()-1));
 }
 
+FailureReason precheck_candidates(const std::vector<Patch>& patches,
+                                  const cv::Size& img_size,
+                                  const GridParams& params)
+{
+    if (patches.size() < 9) return FailureReason::FEW_COMPATIBLE;
+
+    if (params.min_colors > 1) {
+        const int need = std::min(params.min_colors, 8);   // palettes have at most 8 colors
+        const std::string* seen[8];
+        int n_seen = 0;
+        for (const auto& p : patches) {
+            if (n_seen == need) break;
+            bool known = false;
+            for (int i = 0; i < n_seen && !known; ++i) known = *seen[i] == p.color;
+            if (!known) seen[n_seen++] = &p.color;
+        }
+        if (n_seen < need) return FailureReason::FEW_COLORS;
+    }
+
+    // Coverage is the hull of 9 boxes over the image: bounded by the box of all
+    // candidate boxes.
+    if (params.coverage_thresh > 0.f) {
+        Rect all = patches[0].box;
+        for (const auto& p : patches) all |= p.box;
+        if ((double)all.width * (double)all.height <
+            params.coverage_thresh * (double)img_size.width * (double)img_size.height)
+            return FailureReason::SMALL_SPREAD;
+    }
+
+    if (params.area_compat > 0.f) {
+        ArenaScope scope;
+        arena_vector<double> areas(scope.arena().resource());
+        areas.reserve(patches.size());
+        for (const auto& p : patches) areas.push_back(p.area);
+        std::sort(areas.begin(), areas.end());
+        // widest window [areas[i], area_compat × areas[i]]
+        bool found = false;
+        for (size_t i = 0, j = 0; i + 9 <= areas.size() && !found; ++i) {
+            if (j < i) j = i;
+            while (j < areas.size() && areas[j] <= params.area_compat * areas[i]) ++j;
+            found = j - i >= 9;
+        }
+        if (!found) return FailureReason::FEW_COMPATIBLE;
+    }
+    return FailureReason::NONE;
+}
+
 FailureReason detect_grid_and_spacing(
     const std::vector<Patch>& patches,
     GridDetection& out,
-    const GridParams& params)
+    const GridParams& params,
+    const Deadline* dl)
 {
     if (patches.size() < 3) return FailureReason::FEW_PATCHES;
+    if (dl && dl->expired()) return FailureReason::TIMEOUT;
+    // k-means restarts are the optional part: keep one when the budget is tight
+    const int km_attempts = (dl && dl->at_risk(0.5)) ? 1 : 5;
+    if (km_attempts == 1) dl->mark_degraded();
+
+    ArenaScope scope;   // transient clustering buffers
+    FrameArena& arena = scope.arena();
+    std::pmr::memory_resource* mr = arena.resource();
+    const int n = (int)patches.size();
+
+    std::optional<StageTimer> stage(std::in_place, Stage::PcaKmeans);
 
     // PCA rotate
-    std::vector<Point2f> centers; centers.reserve(patches.size());
+    arena_vector<Point2f> centers(mr); centers.reserve(patches.size());
     for (auto& p: patches) centers.push_back(p.center);
     Point2f meanP; Mat eigvecs;
-    pca_rotate(centers, out.rot, meanP, eigvecs);
+    pca_rotate(centers, out.rot, meanP, eigvecs, arena);
 
     // KMeans rows (y')
-    Mat sampY((int)patches.size(),1,CV_32F);
-    for (int i=0;i<(int)patches.size();++i) sampY.at<float>(i,0)=out.rot[i].y;
-    Mat labelsY, centersY;
-    kmeans(sampY, 3, labelsY, TermCriteria(TermCriteria::EPS+TermCriteria::MAX_ITER,100,1e-3), 5, KMEANS_PP_CENTERS, centersY);
+    Mat sampY = arena.mat(n,1,CV_32F);
+    for (int i=0;i<n;++i) sampY.at<float>(i,0)=out.rot[i].y;
+    Mat labelsY = arena.mat(n,1,CV_32S), centersY = arena.mat(3,1,CV_32F);
+    kmeans(sampY, 3, labelsY, TermCriteria(TermCriteria::EPS+TermCriteria::MAX_ITER,100,1e-3), km_attempts, KMEANS_PP_CENTERS, centersY);
+    if (dl && dl->expired()) return FailureReason::TIMEOUT;
 
     struct ClusterInfo{ float cy; int k; };
-    std::vector<ClusterInfo> orderY; orderY.reserve(3);
-    for (int k=0;k<3;++k) orderY.push_back({ centersY.at<float>(k,0), k });
+    std::array<ClusterInfo,3> orderY;
+    for (int k=0;k<3;++k) orderY[k] = { centersY.at<float>(k,0), k };
     std::sort(orderY.begin(), orderY.end(), [](auto&a, auto&b){ return a.cy<b.cy; });
     int label2row[3]; for (int r=0;r<3;++r) label2row[orderY[r].k]=r;
 
     // KMeans cols (x')
-    Mat sampX((int)patches.size(),1,CV_32F);
-    for (int i=0;i<(int)patches.size();++i) sampX.at<float>(i,0)=out.rot[i].x;
-    Mat labelsX, centersX;
-    kmeans(sampX, 3, labelsX, TermCriteria(TermCriteria::EPS+TermCriteria::MAX_ITER,100,1e-3), 5, KMEANS_PP_CENTERS, centersX);
+    Mat sampX = arena.mat(n,1,CV_32F);
+    for (int i=0;i<n;++i) sampX.at<float>(i,0)=out.rot[i].x;
+    Mat labelsX = arena.mat(n,1,CV_32S), centersX = arena.mat(3,1,CV_32F);
+    kmeans(sampX, 3, labelsX, TermCriteria(TermCriteria::EPS+TermCriteria::MAX_ITER,100,1e-3), km_attempts, KMEANS_PP_CENTERS, centersX);
+    if (dl && dl->expired()) return FailureReason::TIMEOUT;
 
     struct Cx{ float x; int k; };
-    std::vector<Cx> orderX; orderX.reserve(3);
-    for (int k=0;k<3;++k) orderX.push_back({ centersX.at<float>(k,0), k });
+    std::array<Cx,3> orderX;
+    for (int k=0;k<3;++k) orderX[k] = { centersX.at<float>(k,0), k };
     std::sort(orderX.begin(), orderX.end(), [](auto&a, auto&b){ return a.x<b.x; });
     int label2col[3]; for (int c=0;c<3;++c) label2col[orderX[c].k]=c;
 
+    stage.reset();
+    stage.emplace(Stage::Assignment);
+
     // Row/Col centers in x',y'
     float rowCenterY[3], colCenterX[3];
-    std::vector<std::vector<int>> byRow(3), byCol(3);
+    arena_vector<arena_vector<int>> byRow(3, mr), byCol(3, mr);
     for (int idx=0; idx<(int)patches.size(); ++idx) {
         int r = label2row[labelsY.at<int>(idx,0)];
         int c = label2col[labelsX.at<int>(idx,0)];
@@ -90,7 +160,7 @@ FailureReason detect_grid_and_spacing(
 
     // Greedy assignment to 9 intersections
     struct Cand { int r,c,idx; float d; };
-    std::vector<Cand> cands; cands.reserve(patches.size()*9);
+    arena_vector<Cand> cands(mr); cands.reserve(patches.size()*9);
     for (int r=0;r<3;++r) for(int c=0;c<3;++c){
         for (int idx=0; idx<(int)patches.size(); ++idx){
             int rr = label2row[labelsY.at<int>(idx,0)];
@@ -106,7 +176,7 @@ FailureReason detect_grid_and_spacing(
     std::sort(cands.begin(), cands.end(), [](auto&a, auto&b){ return a.d<b.d; });
 
     bool cell_used[3][3] = {{0}};
-    std::vector<char> patch_used(patches.size(), 0);
+    arena_vector<char> patch_used(patches.size(), 0, mr);
     int assigned = 0;
     for (const auto& c : cands) {
         if (cell_used[c.r][c.c]) continue;
@@ -129,10 +199,10 @@ FailureReason detect_grid_and_spacing(
         std::sort(col.begin(), col.end(), [&](const Patch&a,const Patch&b){ return out.rot[a.id].y < out.rot[b.id].y; });
         return col;
     };
-    auto mean_vec = [](const std::vector<float>& v){ float s=0.f; for(float x:v) s+=x; return v.empty()?0.f:s/(float)v.size(); };
+    auto mean_vec = [](const arena_vector<float>& v){ float s=0.f; for(float x:v) s+=x; return v.empty()?0.f:s/(float)v.size(); };
 
     bool grid_failed=false;
-    std::vector<float> dx_norm, dy_norm;
+    arena_vector<float> dx_norm(mr), dy_norm(mr);
     for (int r=0;r<3;++r){
         auto row = sort_row_by_xp(r);
         float x1=out.rot[row[0].id].x, x2=out.rot[row[1].id].x, x3=out.rot[row[2].id].x;
@@ -161,3 +231,82 @@ FailureReason detect_grid_and_spacing(
     out.spacing_ok = (out.cvx <= params.cvx_thresh && out.cvy <= params.cvy_thresh);
     return FailureReason::NONE;
 }
+
+static int uf_find(arena_vector<int>& parent, int i) {
+    while (parent[i] != i) { parent[i] = parent[parent[i]]; i = parent[i]; }
+    return i;
+}
+
+static Rect grid_bounds(const GridDetection& gd) {
+    Rect r = gd.grid[0][0].box;
+    for (int i=0;i<3;++i) for (int j=0;j<3;++j) r |= gd.grid[i][j].box;
+    return r;
+}
+
+FailureReason detect_all_grids(
+    const std::vector<Patch>& patches,
+    std::vector<GridDetection>& out,
+    const GridParams& params,
+    const Deadline* dl)
+{
+    out.clear();
+    if (patches.size() < 3) return FailureReason::FEW_PATCHES;
+    ArenaScope scope;
+    std::pmr::memory_resource* mr = scope.arena().resource();
+
+    // Proximity grouping (union-find): neighbours inside one marker sit about
+    // one patch side + gap apart, separate markers are further away.
+    const int n = (int)patches.size();
+    arena_vector<int> parent(n, mr);
+    for (int i=0;i<n;++i) parent[i]=i;
+    for (int i=0;i<n;++i) for (int j=i+1;j<n;++j) {
+        float side = 0.5f*(float)(std::sqrt(patches[i].area) + std::sqrt(patches[j].area));
+        float dx = patches[i].center.x - patches[j].center.x;
+        float dy = patches[i].center.y - patches[j].center.y;
+        float lim = params.group_link * side;
+        if (dx*dx + dy*dy <= lim*lim) parent[uf_find(parent,i)] = uf_find(parent,j);
+    }
+    arena_vector<arena_vector<int>> groups(mr);
+    arena_vector<int> root2group(n, -1, mr);
+    for (int i=0;i<n;++i) {
+        int r = uf_find(parent,i);
+        if (root2group[r] < 0) { root2group[r] = (int)groups.size(); groups.emplace_back(); }
+        groups[root2group[r]].push_back(i);
+    }
+
+    auto single = [&]() {
+        GridDetection gd;
+        FailureReason fr = detect_grid_and_spacing(patches, gd, params, dl);
+        if (fr == FailureReason::NONE) out.push_back(std::move(gd));
+        return fr;
+    };
+    if (groups.size() == 1) return single();
+
+    // Largest groups first so a dense marker wins over a stray neighbour.
+    std::sort(groups.begin(), groups.end(), [](auto&a, auto&b){ return a.size()>b.size(); });
+    arena_vector<Rect> taken(mr);
+    for (const auto& g : groups) {
+        if (g.size() < 9) break;
+        if (dl && dl->expired()) return out.empty() ? FailureReason::TIMEOUT : FailureReason::NONE;
+        // detect_grid_and_spacing indexes rot by Patch::id -> use group-local ids
+        std::vector<Patch> local; local.reserve(g.size());
+        for (int k=0;k<(int)g.size();++k) { local.push_back(patches[g[k]]); local.back().id = k; }
+        GridDetection gd;
+        if (detect_grid_and_spacing(local, gd, params, dl) != FailureReason::NONE) continue;
+
+        Rect bounds = grid_bounds(gd);
+        bool overlaps = false;
+        for (const Rect& t : taken) if ((t & bounds).area() > 0) { overlaps = true; break; }
+        if (overlaps) continue;
+        taken.push_back(bounds);
+
+        std::vector<Point2f> rot(patches.size());
+        for (int k=0;k<(int)g.size();++k) rot[g[k]] = gd.rot[k];
+        gd.rot.swap(rot);
+        for (int i=0;i<3;++i) for (int j=0;j<3;++j) gd.grid[i][j].id = g[gd.grid[i][j].id];
+        out.push_back(std::move(gd));
+    }
+    if (!out.empty()) return FailureReason::NONE;
+    if (dl && dl->expired()) return FailureReason::TIMEOUT;
+    return single();
+}
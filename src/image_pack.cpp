@@ -0,0 +1,109 @@
+#include "image_pack.hpp"
+#include "hash.hpp"
+#include <cstdio>
+#include <cstring>
+
+static const char kPackMagic[8] = { 'M','K','I','M','G','P','K','1' };
+static const uint32_t kPackVersion = 1;
+static const uint64_t kPackAlign = 64;
+
+struct PackHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t index_offset;
+};
+struct PackEntry {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t content_hash;
+    uint32_t name_len;
+    uint32_t reserved;
+};
+static_assert(sizeof(PackHeader) == 32, "pack layout");
+static_assert(sizeof(PackEntry) == 32, "pack layout");
+
+bool ImagePack::open(const std::string& path) {
+    close();
+    if (!map_.open(path) || map_.size() < sizeof(PackHeader)) { close(); return false; }
+    const unsigned char* base = map_.data();
+    const uint64_t file_size = map_.size();
+    PackHeader h;
+    std::memcpy(&h, base, sizeof(h));
+    if (std::memcmp(h.magic, kPackMagic, 8) != 0 || h.version != kPackVersion ||
+        h.index_offset > file_size || h.count > (file_size - h.index_offset) / sizeof(PackEntry)) {
+        close();
+        return false;
+    }
+
+    const unsigned char* p = base + h.index_offset;
+    const unsigned char* names = p + h.count * sizeof(PackEntry);
+    const unsigned char* end = base + file_size;
+    entries_.reserve((size_t)h.count);
+    for (uint64_t i = 0; i < h.count; ++i, p += sizeof(PackEntry)) {
+        PackEntry pe;
+        std::memcpy(&pe, p, sizeof(pe));
+        if (pe.offset > h.index_offset || pe.size > h.index_offset - pe.offset ||
+            pe.name_len > (uint64_t)(end - names)) {
+            close();
+            return false;
+        }
+        entries_.push_back(Entry{ std::string((const char*)names, pe.name_len), pe.offset, pe.size, pe.content_hash });
+        names += pe.name_len;
+    }
+    map_.advise_sequential();   // entries are decoded in archive order (--pack)
+    return true;
+}
+
+void ImagePack::close() {
+    map_.close();
+    entries_.clear();
+}
+
+bool ImagePackWriter::open(const std::string& path) {
+    path_ = path;
+    entries_.clear();
+    out_.open(path + ".tmp", std::ios::binary | std::ios::trunc);
+    if (!out_) return false;
+    PackHeader h{};   // rewritten by finish()
+    out_.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    pos_ = sizeof(h);
+    return (bool)out_;
+}
+
+bool ImagePackWriter::add(const std::string& name, const unsigned char* data, size_t size) {
+    static const char zeros[kPackAlign] = {};
+    const uint64_t pad = (kPackAlign - pos_ % kPackAlign) % kPackAlign;
+    out_.write(zeros, (std::streamsize)pad);
+    pos_ += pad;
+    entries_.push_back(Entry{ name, pos_, size, hash64(data, size) });
+    out_.write(reinterpret_cast<const char*>(data), (std::streamsize)size);
+    pos_ += size;
+    return (bool)out_;
+}
+
+bool ImagePackWriter::finish() {
+    PackHeader h{};
+    std::memcpy(h.magic, kPackMagic, 8);
+    h.version = kPackVersion;
+    h.count = entries_.size();
+    h.index_offset = pos_;
+    for (const Entry& e : entries_) {
+        PackEntry pe{};
+        pe.offset = e.offset;
+        pe.size = e.size;
+        pe.content_hash = e.hash;
+        pe.name_len = (uint32_t)e.name.size();
+        out_.write(reinterpret_cast<const char*>(&pe), sizeof(pe));
+    }
+    for (const Entry& e : entries_) out_.write(e.name.data(), (std::streamsize)e.name.size());
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    out_.close();
+    if (!out_) return false;
+#ifdef _WIN32
+    std::remove(path_.c_str());   // rename() does not replace an existing file there
+#endif
+    return std::rename((path_ + ".tmp").c_str(), path_.c_str()) == 0;
+}
@@ -3,15 +3,46 @@
 #include "color_segmentation.hpp"
 #include "grid_detector.hpp"
 #include "coverage.hpp"
+#include "pipeline.hpp"
+#include "result_cache.hpp"
+#include "mapped_file.hpp"
+#include "hash.hpp"
+#include "alloc_stats.hpp"
+#include "frame_arena.hpp"
+#include "stage_profiler.hpp"
+#include "shard.hpp"
+#include "frame_gate.hpp"
+#include "strip_source.hpp"
+#include "mem_stats.hpp"
+#include "shm_ring.hpp"
+#include "overlay_writer.hpp"
+#include "dir_watcher.hpp"
+#include "frame_batch.hpp"
+#include "metrics.hpp"
+#include "image_pack.hpp"
+#include "run_journal.hpp"
+#include "yuv_frame.hpp"
 
 #include <opencv2/opencv.hpp>
 #include <filesystem>
 #include <chrono>
 #include <iostream>
+#include <fstream>
 #include <cmath>
+#include <csignal>
+#include <algorithm>
+#include <optional>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
 
 using clk = std::chrono::high_resolution_clock;
 
+// --watch runs until asked to stop; the summary is still printed.
+static volatile std::sig_atomic_t g_stop = 0;
+static void on_stop_signal(int) { g_stop = 1; }
+
 static void emit_marker_result(const std::string& name, bool ok, FailureReason fr, bool debug_mode) {
     if (debug_mode) {
         if (ok)  std::cout << "marker_found " << name << "\n";
@@ -24,6 +55,66 @@ static void emit_marker_result(const std::string& name, bool ok, FailureReason f
     }
 }
 
+// Per-item measurement start: latency + allocation counters + memory peaks.
+// A --batch run is measured once for all its images (items): each reports an
+// equal share of the elapsed time; counters and peaks are the batch's.
+struct ItemStart {
+    ItemStart() { mem_image_begin(); }
+    clk::time_point t0 = clk::now();
+    size_t items = 1;
+    AllocStats heap = alloc_stats_thread();
+    uint64_t arena_allocs = FrameArena::local().allocs();
+    uint64_t arena_bytes = FrameArena::local().bytes();
+};
+
+// Prints one image's outcome in the selected output mode.
+static void report_image(const std::string& path, const ImageResult& res, bool debug_mode, double elapsed_ms) {
+    const long long ms = (long long)elapsed_ms;
+    if (res.fr == FailureReason::ASSIGN_GRID || res.fr == FailureReason::SPACING || res.fr == FailureReason::TIMEOUT ||
+        res.fr == FailureReason::FEW_COLORS || res.fr == FailureReason::FEW_COMPATIBLE ||
+        res.fr == FailureReason::SMALL_SPREAD) {
+        emit_marker_result(path, false, res.fr, debug_mode);
+        if (!debug_mode) std::cout << path << " 0%\n";
+        if (debug_mode) std::cout << path << " took " << ms << " ms\n";
+        return;
+    }
+    if (res.markers.empty() || res.fr == FailureReason::BAD_BBOX) {
+        emit_marker_result(path, false, res.fr, debug_mode);
+        if (!debug_mode) std::cout << path << " 0%\n";
+        return;
+    }
+
+    emit_marker_result(path, res.ok, res.fr, debug_mode);
+
+    if (res.ok) {
+        if (!debug_mode) std::cout << path;
+        for (const auto& m : res.markers) {
+            if (!m.ok) break;
+            int pct = (int)std::lround(m.cov.ratio * 100.0);
+            if (!debug_mode) std::cout << " " << pct << "%";
+            if (debug_mode) {
+                std::cout << "[coverage] hull=" << m.cov.hull_area
+                    << " image=" << m.cov.image_area
+                    << " ratio=" << m.cov.ratio << " (" << pct << "%)\n";
+            }
+        }
+        if (!debug_mode) std::cout << "\n";
+    }
+    else {
+        const MarkerResult& m = res.markers.front();
+        if (!debug_mode) std::cout << path << " 0%\n";
+        if (debug_mode) {
+            std::cout << "[final] cvx=" << m.gd.cvx << " cvy=" << m.gd.cvy
+                << " coverage_ratio=" << m.cov.ratio << "\n";
+        }
+    }
+
+    if (debug_mode) {
+        if (ms > 200) std::cerr << "[warn] " << path << " took " << ms << " ms (>200ms)\n";
+        else          std::cout << path << " took " << ms << " ms\n";
+    }
+}
+
 int main(int argc, char** argv) {
     if (argc < 2) {
         std::cout << "the program needs pictures names as arguments\n";
@@ -31,105 +122,517 @@ int main(int argc, char** argv) {
     }
 
     bool debug_mode = false;
+    bool multi_mode = false; // report every marker in the frame
+    std::string cache_path;  // --cache <file>: content-hash keyed result cache
+    double budget_ms = 0.0;  // --budget-ms <ms>: enforced per-image latency ceiling (0 = off)
+    bool prefilter = true;   // thumbnail pre-rejection before full segmentation
+    bool perf_mode = false;  // --perf: per-stage timing + hardware counters
     std::vector<std::string> images;
+    ShardSpec shard;         // --shard i/N: only this host's subset of the inputs
+    std::string results_path; // --results <file>: per-image TSV for --merge
+    std::string video_src;    // --video <file|camera index>: process a frame stream
+    FrameGateParams gatep;    // --gate-every K / --gate-threshold t (K=0 disables the gate)
+    int strip_rows = 0;       // --strip-rows N: decode + segment N rows at a time (0 = whole image)
+    double mem_budget_mb = 0; // --mem-budget <MB>: pick lower-memory strategies to stay under it
+    std::string shm_name;     // --shm <name>: frames from a shared-memory ring (shm_ring.hpp)
+    OverlayParams overlayp;   // --overlay <dir> [--overlay-every N] [--overlay-failures]
+    std::string watch_dir;    // --watch <dir>: process files as they land, until SIGINT/SIGTERM
+    int batch_size = 0;       // --batch N: detect thumbnail-sized files N at a time (frame_batch.hpp)
+    std::string metrics_path; // --metrics <file.prom> [--metrics-interval s]: Prometheus textfile export
+    double metrics_interval = 15.0;
+    std::vector<std::string> packs; // --pack <file.mkpack>: every image of a packed archive (image_pack.hpp)
+    std::string journal_path; // --journal <file>: record finished inputs, skip them when rerun (run_journal.hpp)
+    double retry_scale = 0.0; // --retry <s>: staged retry of candidate failures, area bounds relaxed by s
     for (int i = 1; i < argc; ++i) {
         std::string a = argv[i];
+        if (a == "--merge") {
+            // --merge <results files...>: combine shard outputs and exit
+            return merge_results(std::vector<std::string>(argv + i + 1, argv + argc), std::cout);
+        }
+        if (a == "--shard" && i + 1 < argc) {
+            if (!parse_shard(argv[++i], shard)) { std::cerr << "invalid --shard, expected i/N\n"; return 1; }
+            continue;
+        }
+        if (a == "--results" && i + 1 < argc) { results_path = argv[++i]; continue; }
         if (a == "--debug") { debug_mode = true; continue; }
+        if (a == "--multi") { multi_mode = true; continue; }
+        if (a == "--cache" && i + 1 < argc) { cache_path = argv[++i]; continue; }
+        if (a == "--budget-ms" && i + 1 < argc) { budget_ms = std::atof(argv[++i]); continue; }
+        if (a == "--no-prefilter") { prefilter = false; continue; }
+        if (a == "--perf") { perf_mode = true; continue; }
+        if (a == "--video" && i + 1 < argc) { video_src = argv[++i]; continue; }
+        if (a == "--gate-every" && i + 1 < argc) { gatep.max_skip = std::atoi(argv[++i]); continue; }
+        if (a == "--gate-threshold" && i + 1 < argc) { gatep.threshold = std::atof(argv[++i]); continue; }
+        if (a == "--strip-rows" && i + 1 < argc) { strip_rows = std::max(0, std::atoi(argv[++i])); continue; }
+        if (a == "--watch" && i + 1 < argc) { watch_dir = argv[++i]; continue; }
+        if (a == "--batch" && i + 1 < argc) { batch_size = std::max(0, std::atoi(argv[++i])); continue; }
+        if (a == "--metrics" && i + 1 < argc) { metrics_path = argv[++i]; continue; }
+        if (a == "--pack" && i + 1 < argc) { packs.push_back(argv[++i]); continue; }
+        if (a == "--journal" && i + 1 < argc) { journal_path = argv[++i]; continue; }
+        if (a == "--retry" && i + 1 < argc) { retry_scale = std::max(0.0, std::atof(argv[++i])); continue; }
+        if (a == "--metrics-interval" && i + 1 < argc) { metrics_interval = std::atof(argv[++i]); continue; }
+        if (a == "--overlay" && i + 1 < argc) { overlayp.dir = argv[++i]; continue; }
+        if (a == "--overlay-every" && i + 1 < argc) { overlayp.every = std::atoi(argv[++i]); continue; }
+        if (a == "--overlay-failures") { overlayp.failures_only = true; continue; }
+        if (a == "--shm" && i + 1 < argc) { shm_name = argv[++i]; continue; }
+        if (a == "--mem-budget" && i + 1 < argc) { mem_budget_mb = std::max(0.0, std::atof(argv[++i])); continue; }
+        if (!shard_selects(shard, a)) continue; // another shard's input: don't even stat it
         if (std::filesystem::exists(a)) images.push_back(a);
         else std::cerr << a << " is not a valid picture path\n";
     }
-    if (images.empty()) return 1;
+    if (images.empty() && packs.empty() && video_src.empty() && shm_name.empty() && watch_dir.empty()) return 1;
 
     int pass_count = 0, fail_count = 0;
+    size_t item_index = 0;   // overlay sampling
     bool any_fail = false;
 
-    SegmentationParams segp; segp.debug = debug_mode;
-    GridParams gp; gp.debug = debug_mode;
-    // thresholds as in your tuned logic
-    gp.coverage_thresh = 0.45f; // must-have
-    gp.coverage_fallback = 0.55f; // accept even if spacing failed
-    gp.coverage_soft = 0.50f; // soft acceptance if cv within near-range
-
-    for (const auto& path : images) {
-        auto t0 = clk::now();
-
-        cv::Mat img = cv::imread(path, cv::IMREAD_COLOR);
-        if (img.empty()) {
-            emit_marker_result(path, false, FailureReason::FEW_PATCHES, debug_mode);
-            if (!debug_mode) std::cout << path << " 0%\n";
-            ++fail_count; any_fail = true;
-            continue;
+    SegmentationParams segp = default_segmentation_params(); segp.debug = debug_mode;
+    if (!prefilter) segp.prefilter_side = 0;
+    segp.mem_budget = (size_t)(mem_budget_mb * 1024.0 * 1024.0);
+    segp.retry_area_scale = retry_scale;
+    GridParams gp = default_grid_params(); gp.debug = debug_mode;
+
+    std::ofstream results;
+    if (!results_path.empty()) {
+        results.open(results_path, std::ios::trunc);
+        if (!results) { std::cerr << "cannot write " << results_path << "\n"; return 1; }
+        write_results_header(results);
+    }
+
+    alloc_stats_install();
+    if (perf_mode && !stage_profiler_enable())
+        std::cerr << "[perf] hardware counters not permitted, timing only\n";
+
+    ResultCache cache;
+    bool use_cache = !cache_path.empty();
+    if (use_cache && !cache.open(cache_path, cache_params_hash(segp, gp, multi_mode))) {
+        std::cerr << "cannot open cache " << cache_path << "\n";
+        use_cache = false;
+    }
+
+    // Finished inputs are appended as they complete; a rerun after a crash or
+    // kill replays them from the journal instead of processing them again.
+    RunJournal journal;
+    const bool use_journal = !journal_path.empty();
+    if (use_journal) {
+        bool mismatch = false;
+        if (!journal.open(journal_path, cache_params_hash(segp, gp, multi_mode), mismatch)) {
+            if (mismatch) std::cerr << journal_path << " was written with other parameters, use a new journal\n";
+            else          std::cerr << "cannot open journal " << journal_path << "\n";
+            return 1;
         }
+        if (journal.loaded()) std::cerr << "[journal] resuming, " << journal.loaded() << " inputs already done\n";
+    }
 
-        // 1) Color segmentation -> candidate patches
-        auto patches = segment_color_patches(img, segp);
-        if (patches.size() < 3) {
-            emit_marker_result(path, false, FailureReason::FEW_PATCHES, debug_mode);
-            if (!debug_mode) std::cout << path << " 0%\n";
-            ++fail_count; any_fail = true;
-            continue;
+    // Counters are per thread; the exporter thread sums and writes them.
+    std::optional<MetricsExporter> metrics;
+    if (!metrics_path.empty()) metrics.emplace(metrics_path, metrics_interval);
+
+    // Rendering + PNG encoding happen on the writer's thread, never in the timed path.
+    std::optional<OverlayWriter> overlay;
+    if (!overlayp.dir.empty()) overlay.emplace(overlayp);
+
+    // 1-4) segmentation -> grid -> coverage -> decision
+    auto detect = [&](const cv::Mat& img, const Deadline* dlp) {
+        ImageResult r;
+        if (img.empty()) r.fr = FailureReason::FEW_PATCHES;
+        else             r = process_image(img, segp, gp, multi_mode, dlp);
+        return r;
+    };
+    // Decodes the file itself: whole, or strip by strip under --strip-rows or
+    // when --mem-budget cannot afford the decoded image plus its copies.
+    auto detect_file = [&](const std::string& path, const Deadline* dlp) {
+        if (strip_rows <= 0 && segp.mem_budget == 0) return detect(cv::imread(path, cv::IMREAD_COLOR), dlp);
+        ImageResult r;
+        auto src = open_strip_source(path);
+        if (!src) { r.fr = FailureReason::FEW_PATCHES; return r; }
+        int rows = strip_rows;
+        if (rows <= 0) {
+            const MemPlan plan = plan_memory(cv::Size(src->width(), src->height()), segp.mem_budget);
+            if (debug_mode)
+                std::cout << "[mem] " << path << ": strategy=" << mem_strategy_name(plan.strategy)
+                    << " estimate=" << plan.estimate / 1024 << " KB"
+                    << (plan.fits ? "" : " (exceeds --mem-budget even at one row per strip)") << "\n";
+            if (plan.strategy == MemStrategy::Strips && src->streaming()) rows = plan.strip_rows;
         }
+        if (rows <= 0) return detect(src->read_all(), dlp);  // whole image; process_image applies the plan
+        r = process_image_strips(*src, segp, gp, rows, multi_mode, dlp);
+        if (debug_mode && !src->streaming())
+            std::cout << "[strip] " << path << ": no streaming decoder, decoded whole\n";
+        return r;
+    };
+    // stamp: set for a file or pack entry, which --journal records with it (stream
+    // frames are not). Results degraded by --budget-ms are not recorded: a rerun
+    // redoes them.
+    auto finish = [&](const std::string& name, const ImageResult& res, const ItemStart& st, std::optional<uint64_t> stamp) {
+        const double ms = std::chrono::duration<double, std::milli>(clk::now() - st.t0).count() / (double)st.items;
+        report_image(name, res, debug_mode, ms);
+        const size_t peak = mem_image_peaks().total;
+        if (results.is_open()) write_result_row(results, make_result_row(name, res, ms, peak));
+        if (stamp && use_journal && !res.degraded && !journal.append(name, *stamp, res, ms, peak))
+            std::cerr << "[journal] write failed for " << name << "\n";
+        metrics_record_image(res.fr, ms);
+        if (debug_mode) {
+            if (res.retry != RetryStage::None) std::cout << "[retry] " << name << " accepted after " << retry_stage_name(res.retry) << "\n";
+            // heap: this thread only, OpenCV's worker threads are not included
+            std::cout << "[alloc]";
+#ifdef MARKER_COUNT_ALLOCS
+            const AllocStats heap1 = alloc_stats_thread();
+            std::cout << " thread_heap=" << (heap1.count - st.heap.count) << " (" << (heap1.bytes - st.heap.bytes) << " B)";
+#endif
+            std::cout << " arena=" << (FrameArena::local().allocs() - st.arena_allocs)
+                << " (" << (FrameArena::local().bytes() - st.arena_bytes) << " B)\n";
+            const MemPeaks mp = mem_image_peaks();
+            std::cout << "[mem] peak=" << mp.total / 1024 << " KB";
+            for (int s = 0; s < (int)Stage::Count; ++s)
+                if (mp.stage[s]) std::cout << " " << stage_name((Stage)s) << "=" << mp.stage[s] / 1024;
+            std::cout << "\n";
+        }
+        if (res.ok) ++pass_count;
+        else { ++fail_count; any_fail = true; }
+    };
+    // An input finished by an earlier run, unchanged since: reported and counted
+    // as recorded, so the output and Summary match an uninterrupted run.
+    size_t replayed = 0;
+    auto replay = [&](const std::string& name, uint64_t stamp) {
+        JournalEntry je;
+        if (!use_journal || !journal.lookup(name, stamp, je)) return false;
+        report_image(name, je.res, debug_mode, je.ms);
+        if (results.is_open()) write_result_row(results, make_result_row(name, je.res, je.ms, je.peak_bytes));
+        if (je.res.ok) ++pass_count;
+        else { ++fail_count; any_fail = true; }
+        ++item_index;
+        ++replayed;
+        return true;
+    };
 
-        // 2) Grid detection + spacing validation (PCA-rotated coords, CV thresholds)
-        GridDetection gd;
-        FailureReason fr = detect_grid_and_spacing(patches, gd, gp);
-        if (fr == FailureReason::ASSIGN_GRID || fr == FailureReason::SPACING) {
-            emit_marker_result(path, false, fr, debug_mode);
-            if (!debug_mode) std::cout << path << " 0%\n";
-            ++fail_count; any_fail = true;
+    // --batch: small decoded files wait here and are detected together; each is
+    // reported (and cached) when its batch runs. Strips, memory budgets and
+    // deadlines are per image, so they turn batching off.
+    std::optional<FrameBatch> batch;
+    if (batch_size > 1) {
+        if (strip_rows > 0 || segp.mem_budget > 0 || budget_ms > 0 || retry_scale > 0)
+            std::cerr << "[batch] --batch ignored with --strip-rows, --mem-budget, --budget-ms or --retry\n";
+        else batch.emplace(batch_size);
+    }
+    struct Queued { std::string path; uint64_t key; bool cacheable; uint64_t stamp; };
+    std::vector<Queued> queued;
+    auto run_batch = [&] {
+        if (queued.empty()) return;
+        ItemStart st;   // one measurement for the batch, split evenly over its images
+        st.items = queued.size();
+        const std::vector<ImageResult> rs = process_batch(*batch, segp, gp, multi_mode);
+        for (size_t i = 0; i < queued.size(); ++i) {
+            if (queued[i].cacheable) cache.store(queued[i].key, rs[i]);
+            finish(queued[i].path, rs[i], st, queued[i].stamp);
+            if (overlay && overlay->wants(item_index, rs[i].ok)) overlay->submit_frame(queued[i].path, batch->frame((int)i), rs[i]);
+            ++item_index;
+        }
+        if (debug_mode) std::cout << "[batch] " << queued.size() << " frames of " << batch->frame_size().width << "x" << batch->frame_size().height << "\n";
+        queued.clear();
+        batch->clear();
+    };
+    // true: img is queued in the batch (a frame of another size runs the queue first).
+    auto enqueue = [&](const std::string& path, const cv::Mat& img, uint64_t key, bool cacheable, uint64_t stamp) {
+        if (!batch || img.empty() || (size_t)img.total() > (size_t)kBatchMaxFramePixels) return false;
+        if (!batch->accepts(img)) run_batch();
+        if (!batch->add(img)) return false;
+        queued.push_back({path, key, cacheable, stamp});
+        if (batch->full()) run_batch();
+        return true;
+    };
 
-            if (debug_mode) {
-                auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(clk::now() - t0).count();
-                std::cout << path << " took " << ms << " ms\n";
+    // One input file end to end: cache, decode/strips, detection, report, overlay.
+    auto process_file = [&](const std::string& path) {
+        const uint64_t stamp = use_journal ? input_stamp(path) : 0;
+        if (replay(path, stamp)) return;
+        ItemStart st;
+        const Deadline dl = budget_ms > 0 ? Deadline::in_ms(budget_ms) : Deadline();
+        const Deadline* dlp = budget_ms > 0 ? &dl : nullptr;
+
+        ImageResult res;
+        if (use_cache) {
+            // hash the raw bytes; decode only on a miss
+            MappedFile mf;
+            uint64_t key = 0;
+            if (mf.open(path)) key = hash64(mf.data(), mf.size());
+            if (!mf.is_open() || !cache.lookup(key, res)) {
+                if (strip_rows > 0 || segp.mem_budget > 0) res = detect_file(path, dlp);
+                else {
+                    cv::Mat img;
+                    if (mf.size() > 0)
+                        img = cv::imdecode(cv::Mat(1, (int)mf.size(), CV_8U, const_cast<unsigned char*>(mf.data())), cv::IMREAD_COLOR);
+                    if (enqueue(path, img, key, mf.is_open(), stamp)) return;
+                    res = detect(img, dlp);
+                }
+                if (mf.is_open() && !res.degraded) cache.store(key, res);
             }
-            continue;
         }
+        else if (batch) {
+            cv::Mat img = cv::imread(path, cv::IMREAD_COLOR);
+            if (enqueue(path, img, 0, false, stamp)) return;
+            res = detect(img, dlp);
+        }
+        else {
+            res = detect_file(path, dlp);
+        }
+        finish(path, res, st, stamp);
+        if (overlay && overlay->wants(item_index, res.ok)) overlay->submit_file(path, res);
+        ++item_index;
+    };
+
+    for (const auto& path : images) process_file(path);
+
+    // One packed entry: decoded straight from the mapped archive. The stored
+    // hash is the cache key, so a hit reads none of the entry's bytes.
+    auto process_packed = [&](const ImagePack& pack, size_t e) {
+        const std::string& name = pack.name(e);
+        const uint64_t key = pack.content_hash(e);   // cache key and journal stamp
+        if (replay(name, key)) return;
+        ItemStart st;
+        const Deadline dl = budget_ms > 0 ? Deadline::in_ms(budget_ms) : Deadline();
+        const Deadline* dlp = budget_ms > 0 ? &dl : nullptr;
+
+        auto decode = [&] {
+            return cv::imdecode(cv::Mat(1, (int)pack.bytes(e), CV_8U, const_cast<unsigned char*>(pack.data(e))),
+                                cv::IMREAD_COLOR);
+        };
+        ImageResult res;
+        cv::Mat img;
+        if (!use_cache || !cache.lookup(key, res)) {
+            if (pack.bytes(e) > 0) img = decode();
+            if (enqueue(name, img, key, use_cache, key)) return;
+            res = detect(img, dlp);
+            if (use_cache && !res.degraded) cache.store(key, res);
+        }
+        finish(name, res, st, key);
+        if (overlay && overlay->wants(item_index, res.ok)) {
+            if (img.empty() && pack.bytes(e) > 0) img = decode();
+            overlay->submit_frame(name, img, res);
+        }
+        ++item_index;
+    };
 
-        // 3) Coverage (convex hull of 9 rect corners) vs IMAGE area
-        // NOTE: ensure your coverage.hpp/.cpp signature is:
-        // CoverageResult compute_coverage_from_grid(const Patch grid[3][3], cv::Size imageSize);
-        auto cov = compute_coverage_from_grid(gd.grid, img.size());
-        if (cov.hull_area <= 0.0 || cov.image_area <= 0.0) {
-            emit_marker_result(path, false, FailureReason::BAD_BBOX, debug_mode);
-            if (!debug_mode) std::cout << path << " 0%\n";
-            ++fail_count; any_fail = true;
+    for (const auto& pack_path : packs) {
+        ImagePack pack;
+        if (!pack.open(pack_path)) {
+            std::cerr << pack_path << " is not a readable image pack\n";
+            any_fail = true;
             continue;
         }
+        // Processing order: this shard's entries in archive order. Pages are
+        // requested kPackPrefetchBytes ahead of the decoder in exactly that
+        // order (cache hits and journaled entries are not fetched at all) and
+        // dropped behind it.
+        std::vector<size_t> order;
+        for (size_t e = 0; e < pack.size(); ++e)
+            if (shard_selects(shard, pack.name(e))) order.push_back(e);
+        size_t pf = 0;        // next position in order to prefetch
+        size_t ahead = 0;     // bytes of order[k, pf)
+        for (size_t k = 0; k < order.size(); ++k) {
+            while (pf < order.size() && (pf == k || ahead < kPackPrefetchBytes)) {
+                const size_t e = order[pf++];
+                if ((!use_cache || !cache.contains(pack.content_hash(e))) &&
+                    (!use_journal || !journal.contains(pack.name(e), pack.content_hash(e))))
+                    pack.prefetch(e);
+                ahead += pack.bytes(e);
+            }
+            process_packed(pack, order[k]);
+            ahead -= pack.bytes(order[k]);
+            pack.release(order[k]);
+        }
+        run_batch();   // queued frames are copies; the mapping can go
+        if (debug_mode) std::cout << "[pack] " << pack_path << ": " << order.size() << " of " << pack.size() << " entries\n";
+    }
+    run_batch();
 
-        // 4) Thresholds + fallbacks
-        bool spacing_ok = gd.spacing_ok;
-        if (!spacing_ok && cov.ratio >= gp.coverage_fallback) spacing_ok = true;
-        if (!spacing_ok && gd.cvx <= 0.60f && gd.cvy <= 0.70f && cov.ratio >= gp.coverage_soft) spacing_ok = true;
+    if (!watch_dir.empty()) {
+        // Long-lived: files are processed as soon as they are complete, and each
+        // result is flushed right away for whoever consumes the stream.
+        DirWatcher watcher;
+        if (!watcher.open(watch_dir)) {
+            std::cerr << watch_dir << " cannot be watched (not a directory, or no inotify)\n";
+            return 1;
+        }
+        std::signal(SIGINT, on_stop_signal);
+        std::signal(SIGTERM, on_stop_signal);
+        std::cerr << "[watch] " << watch_dir << ": waiting for files (SIGINT/SIGTERM to stop)\n";
+        auto flush_outputs = [&] {
+            std::cout.flush();
+            if (results.is_open()) results.flush();
+            if (use_cache) cache.flush();   // incremental append: a killed watcher keeps its cache
+        };
+        // The backlog listing races the first events, IN_CLOSE_WRITE comes once
+        // per writer that closes the file, and an overflow lists everything
+        // again: each (path, mtime, size) is processed once. A rewritten file
+        // differs and is processed again, as --journal does across restarts.
+        // One entry per distinct path.
+        std::unordered_map<std::string, uint64_t> handled;
+        auto already_handled = [&](const std::string& path) {
+            const uint64_t stamp = input_stamp(path);
+            if (stamp == 0) return true;   // gone again: nothing to process
+            auto ins = handled.emplace(path, stamp);
+            if (ins.second) return false;
+            if (ins.first->second == stamp) return true;
+            ins.first->second = stamp;
+            return false;
+        };
+        std::vector<std::string> ready = watcher.list();   // whatever landed before we started
+        do {
+            for (const auto& path : ready) {
+                if (g_stop) break;
+                if (!shard_selects(shard, path)) continue;
+                if (already_handled(path)) continue;
+                if (!cv::haveImageReader(path)) {
+                    if (debug_mode) std::cout << "[watch] skipping " << path << " (not an image)\n";
+                    continue;
+                }
+                process_file(path);
+                flush_outputs();
+            }
+            if (!queued.empty()) { run_batch(); flush_outputs(); }   // a batch never waits for the next burst
+            ready.clear();
+        } while (!g_stop && watcher.wait(ready, 500));
+    }
 
-        bool ok = (spacing_ok && cov.ratio >= gp.coverage_thresh);
-        emit_marker_result(path, ok, ok ? FailureReason::NONE : FailureReason::LOW_COVERAGE, debug_mode);
+    if (!video_src.empty()) {
+        // Frame stream: the gate reuses the last result while the scene is static.
+        cv::VideoCapture cap;
+        bool is_cam = video_src.find_first_not_of("0123456789") == std::string::npos;
+        if (!(is_cam ? cap.open(std::atoi(video_src.c_str())) : cap.open(video_src))) {
+            std::cerr << video_src << " is not a readable video source\n";
+            return 1;
+        }
+        FrameGate gate(gatep);
+        ImageResult last;
+        cv::Mat frame;
+        for (size_t n = 0; cap.read(frame); ++n) {
+            ItemStart st;
+            const Deadline dl = budget_ms > 0 ? Deadline::in_ms(budget_ms) : Deadline();
+            const Deadline* dlp = budget_ms > 0 ? &dl : nullptr;
 
-        if (ok) {
-            ++pass_count;
-            int pct = (int)std::lround(cov.ratio * 100.0);
-            if (!debug_mode) std::cout << path << " " << pct << "%\n";
-            if (debug_mode) {
-                std::cout << "[coverage] hull=" << cov.hull_area
-                    << " image=" << cov.image_area
-                    << " ratio=" << cov.ratio << " (" << pct << "%)\n";
+            if (!gate.unchanged(frame)) {
+                last = detect(frame, dlp);
+                if (last.fr == FailureReason::TIMEOUT) gate.invalidate();
             }
+            finish(video_src + "#" + std::to_string(n), last, st, std::nullopt);
+            if (overlay && overlay->wants(item_index, last.ok)) overlay->submit_frame(video_src + "#" + std::to_string(n), frame, last);
+            ++item_index;
         }
-        else {
-            ++fail_count; any_fail = true;
-            if (!debug_mode) std::cout << path << " 0%\n";
-            if (debug_mode) {
-                std::cout << "[final] cvx=" << gd.cvx << " cvy=" << gd.cvy
-                    << " coverage_ratio=" << cov.ratio << "\n";
+        std::cout << "\nGate: skipped=" << gate.skipped() << " of " << gate.frames() << " frames\n";
+    }
+
+    if (!shm_name.empty()) {
+        // Frames live in the producer's shared pages: detect on a Mat header over
+        // the slot, release the slot only afterwards, publish into the results ring.
+        // 4:2:0 frames are classified from their planes, never converted to BGR.
+        ShmRing frames, results;
+        if (!frames.attach(shm_name)) {
+            std::cerr << shm_name << " is not an attachable frame ring\n";
+            return 1;
+        }
+        const ShmRing::Layout fl = frames.layout();
+        const YuvFormat yuv = (YuvFormat)fl.yuv;
+        const int frame_rows = yuv != YuvFormat::None ? fl.height / 2 * 3 : fl.height;
+        if (yuv != YuvFormat::None) {
+            if (fl.type != CV_8UC1 || fl.width <= 0 || fl.height <= 0 || fl.width % 2 || fl.height % 2 ||
+                fl.step < (uint32_t)fl.width ||
+                (size_t)fl.step * (size_t)frame_rows > fl.payload_bytes) {
+                std::cerr << shm_name << ": " << yuv_format_name(yuv) << " frames must have an even size within the slot size\n";
+                return 1;
             }
         }
+        else if (fl.type != CV_8UC3 || fl.width <= 0 || fl.height <= 0 ||
+            (uint64_t)fl.step < (uint64_t)fl.width * 3 ||
+            (size_t)fl.step * (size_t)fl.height > fl.payload_bytes) {
+            std::cerr << shm_name << ": frames must be non-empty 8-bit BGR within the slot size\n";
+            return 1;
+        }
+        if (debug_mode && yuv != YuvFormat::None)
+            std::cout << "[shm] " << yuv_format_name(yuv) << " frames " << fl.width << "x" << fl.height << "\n";
+        if (!results.attach(shm_results_name(shm_name)))
+            std::cerr << "[shm] no results ring " << shm_results_name(shm_name) << ", results are printed only\n";
+        else if (results.layout().payload_bytes < sizeof(ShmResult)) {
+            std::cerr << "[shm] results ring " << shm_results_name(shm_name) << " has " << results.layout().payload_bytes
+                      << "-byte slots, " << sizeof(ShmResult) << " needed; results are printed only\n";
+            results.close();
+        }
+        FrameGate gate(gatep);
+        ImageResult last;
+        uint64_t unpublished = 0;
+        for (;;) {
+            ShmRing::SlotMeta meta;
+            unsigned char* slot = frames.try_read(meta);
+            if (!slot) {
+                if (frames.closed() && !frames.try_read(meta)) break;
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+            ItemStart st;
+            const Deadline dl = budget_ms > 0 ? Deadline::in_ms(budget_ms) : Deadline();
+            const Deadline* dlp = budget_ms > 0 ? &dl : nullptr;
 
-        if (debug_mode) {
-            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(clk::now() - t0).count();
-            if (ms > 200) std::cerr << "[warn] " << path << " took " << ms << " ms (>200ms)\n";
-            else          std::cout << path << " took " << ms << " ms\n";
+            const cv::Mat frame(frame_rows, fl.width, fl.type, slot, fl.step);   // zero-copy
+            YuvPlanes planes;
+            if (yuv != YuvFormat::None) yuv_planes(frame, yuv, planes);
+            if (!gate.unchanged(yuv != YuvFormat::None ? planes.y : frame)) {
+                last = yuv != YuvFormat::None ? process_image_yuv(planes, segp, gp, multi_mode, dlp) : detect(frame, dlp);
+                if (last.fr == FailureReason::TIMEOUT) gate.invalidate();
+            }
+
+            if (results.is_open()) {
+                ShmRing::SlotMeta* rm = nullptr;
+                if (unsigned char* out = results.try_write(rm)) {
+                    ShmResult r{};
+                    r.frame_seq = meta.seq;
+                    r.timestamp_ns = meta.timestamp_ns;
+                    r.ok = last.ok;
+                    r.reason = (uint8_t)last.fr;
+                    for (const auto& m : last.markers) {
+                        if (!m.ok || r.n_markers == 4) break;
+                        r.pct[r.n_markers++] = (float)(m.cov.ratio * 100.0);
+                    }
+                    r.ms = (float)std::chrono::duration<double, std::milli>(clk::now() - st.t0).count();
+                    rm->seq = meta.seq;
+                    rm->timestamp_ns = meta.timestamp_ns;
+                    std::memcpy(out, &r, sizeof(r));
+                    results.commit_write();
+                }
+                else { results.count_drop(); ++unpublished; }   // reader fell behind: never block detection
+            }
+            finish(shm_name + "#" + std::to_string(meta.seq), last, st, std::nullopt);
+            if (overlay && overlay->wants(item_index, last.ok)) {
+                cv::Mat shown = frame;
+                if (yuv != YuvFormat::None) yuv_to_bgr(frame, yuv, shown);
+                overlay->submit_frame(shm_name + "#" + std::to_string(meta.seq), shown, last);
+            }
+            ++item_index;
+            frames.end_read();   // the producer may reuse the slot from here on
         }
+        std::cout << "\nShm: frames=" << frames.written() << " producer_drops=" << frames.dropped()
+            << " unpublished_results=" << unpublished
+            << " gate_skipped=" << gate.skipped() << "\n";
     }
 
+    if (overlay) {
+        const size_t dropped = overlay->dropped();
+        overlay.reset();   // drains the queue
+        if (debug_mode) std::cout << "[overlay] dropped=" << dropped << " (queue full)\n";
+    }
+
+    if (use_cache) {
+        cache.flush();
+        if (debug_mode) std::cout << "[cache] hits=" << cache.hits() << "\n";
+    }
+
+    if (use_journal) {
+        journal.close();
+        if (debug_mode) std::cout << "[journal] replayed=" << replayed << "\n";
+    }
+
+    if (perf_mode) stage_profiler_report(std::cout);
+    metrics.reset();   // final write
+
     std::cout << "\nSummary: passed=" << pass_count
         << " failed=" << fail_count
         << " out of " << (pass_count + fail_count) << std::endl;
@@ -0,0 +1,83 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                           OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (f == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(f, &sz)) { CloseHandle(f); return false; }
+    file_ = f; open_ = true; size_ = (size_t)sz.QuadPart;
+    if (size_ == 0) return true;
+    mapping_ = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_) { close(); return false; }
+    data_ = static_cast<const unsigned char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!data_) { close(); return false; }
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_) CloseHandle(file_);
+    data_ = nullptr; mapping_ = nullptr; file_ = nullptr;
+    size_ = 0; open_ = false;
+}
+
+void MappedFile::advise_sequential() const {}
+void MappedFile::will_need(size_t, size_t) const {}
+void MappedFile::dont_need(size_t, size_t) const {}
+
+#else
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { ::close(fd); return false; }
+    size_ = (size_t)st.st_size;
+    open_ = true;
+    if (size_ > 0) {
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) { ::close(fd); size_ = 0; open_ = false; return false; }
+        data_ = static_cast<const unsigned char*>(p);
+    }
+    ::close(fd); // the mapping keeps the file referenced
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_) munmap(const_cast<unsigned char*>(data_), size_);
+    data_ = nullptr; size_ = 0; open_ = false;
+}
+
+// madvise wants a page-aligned start. Hints that read widen the range to whole
+// pages; dropping only covers pages entirely inside it, so a neighbour's
+// bytes on a shared page stay mapped.
+static void advise_range(const unsigned char* base, size_t size, size_t offset, size_t len, int advice) {
+    if (!base || offset >= size || len == 0) return;
+    static const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t begin = offset & ~(page - 1);
+    size_t end = std::min(size, offset + len);
+    if (advice == MADV_DONTNEED) {
+        begin = (offset + page - 1) & ~(page - 1);
+        if (end < size) end &= ~(page - 1);
+        if (end <= begin) return;
+    }
+    madvise(const_cast<unsigned char*>(base) + begin, end - begin, advice);
+}
+
+void MappedFile::advise_sequential() const { advise_range(data_, size_, 0, size_, MADV_SEQUENTIAL); }
+void MappedFile::will_need(size_t offset, size_t len) const { advise_range(data_, size_, offset, len, MADV_WILLNEED); }
+void MappedFile::dont_need(size_t offset, size_t len) const { advise_range(data_, size_, offset, len, MADV_DONTNEED); }
+#endif
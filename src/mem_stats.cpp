@@ -0,0 +1,93 @@
+#include "mem_stats.hpp"
+#include "mask_ops.hpp"
+#include "palette.hpp"
+#include <algorithm>
+
+namespace {
+
+struct ThreadMem {
+    size_t live = 0;
+    size_t peak = 0;
+    size_t stage[(int)Stage::Count] = {};
+};
+
+thread_local ThreadMem t_mem;
+
+// Bytes per pixel of each strategy: BGR image + HSV copy + masks.
+const size_t kFullBpp     = 3 + 3 + DefaultPalette::kColors;
+const size_t kPerColorBpp = 3 + 3 + 1;
+const size_t kStripBpp    = 3 + 3 + DefaultPalette::kColors;  // per window row pixel
+// Room for OpenCV temporaries, contours and patch lists on top of the buffers.
+const double kHeadroom = 1.25;
+
+size_t with_headroom(size_t bytes) { return (size_t)((double)bytes * kHeadroom); }
+
+} // namespace
+
+void mem_track_alloc(size_t n) {
+    t_mem.live += n;
+    if (t_mem.live > t_mem.peak) t_mem.peak = t_mem.live;
+}
+
+void mem_track_free(size_t n) {
+    // a buffer freed on another thread than it was allocated on can underflow
+    t_mem.live = n > t_mem.live ? 0 : t_mem.live - n;
+}
+
+void MemCharge::set(size_t bytes) {
+    if (bytes > bytes_) mem_track_alloc(bytes - bytes_);
+    else                mem_track_free(bytes_ - bytes);
+    bytes_ = bytes;
+}
+
+void mem_image_begin() {
+    t_mem.peak = t_mem.live;
+    std::fill(std::begin(t_mem.stage), std::end(t_mem.stage), 0);
+}
+
+MemPeaks mem_image_peaks() {
+    MemPeaks p;
+    p.total = t_mem.peak;
+    std::copy(std::begin(t_mem.stage), std::end(t_mem.stage), p.stage);
+    return p;
+}
+
+size_t mem_stage_begin() {
+    const size_t saved = t_mem.peak;
+    t_mem.peak = t_mem.live;
+    return saved;
+}
+
+void mem_stage_end(Stage s, size_t saved) {
+    size_t& sp = t_mem.stage[(int)s];
+    sp = std::max(sp, t_mem.peak);
+    t_mem.peak = std::max(saved, t_mem.peak);
+}
+
+MemPlan plan_memory(const cv::Size& size, size_t budget_bytes) {
+    MemPlan plan;
+    const size_t px = (size_t)size.width * (size_t)size.height;
+    plan.estimate = with_headroom(px * kFullBpp);
+    if (budget_bytes == 0 || plan.estimate <= budget_bytes) return plan;
+
+    plan.strategy = MemStrategy::PerColor;
+    plan.estimate = with_headroom(px * kPerColorBpp);
+    if (plan.estimate <= budget_bytes) return plan;
+
+    plan.strategy = MemStrategy::Strips;
+    const size_t row = with_headroom((size_t)std::max(size.width, 1) * kStripBpp);
+    const long rows = (long)(budget_bytes / row) - 2 * kMaskHaloRows;
+    plan.strip_rows = (int)std::max(1L, std::min(rows, (long)std::max(size.height, 1)));
+    plan.estimate = row * (size_t)(plan.strip_rows + 2 * kMaskHaloRows);
+    plan.fits = plan.estimate <= budget_bytes;
+    return plan;
+}
+
+const char* mem_strategy_name(MemStrategy s) {
+    switch (s) {
+    case MemStrategy::Full:     return "full";
+    case MemStrategy::PerColor: return "per_color";
+    case MemStrategy::Strips:   return "strips";
+    default:                    return "?";
+    }
+}
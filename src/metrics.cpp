@@ -0,0 +1,194 @@
+#include "metrics.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const int kStages = (int)Stage::Count;
+
+// Histogram upper bounds (seconds, inclusive as Prometheus "le"); one more
+// bucket counts everything above the last bound (+Inf).
+const double kImageBounds[] = { 0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1, 0.2, 0.5, 1, 2, 5 };
+const double kStageBounds[] = { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25 };
+const int kImageBuckets = sizeof(kImageBounds) / sizeof(kImageBounds[0]) + 1;
+const int kStageBuckets = sizeof(kStageBounds) / sizeof(kStageBounds[0]) + 1;
+
+using Counter = std::atomic<uint64_t>;
+
+// One thread's counters. Never freed: a thread that exits keeps its counts,
+// so the exported counters stay monotonic.
+struct alignas(64) ThreadBlock {
+    Counter image[kFailureReasonCount][kImageBuckets];
+    Counter image_ns[kFailureReasonCount];
+    Counter stage[kStages][kStageBuckets];
+    Counter stage_ns[kStages];
+    Counter pixels;
+};
+
+std::atomic<bool> g_enabled{false};
+std::mutex g_mutex;
+std::vector<std::unique_ptr<ThreadBlock>> g_blocks;   // guarded by g_mutex
+thread_local ThreadBlock* t_block = nullptr;
+const double g_start_s = (double)std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count() / 1e3;
+
+ThreadBlock& local_block() {
+    if (!t_block) {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_blocks.push_back(std::make_unique<ThreadBlock>());   // value-initialized: all zero
+        t_block = g_blocks.back().get();
+    }
+    return *t_block;
+}
+
+// Only the owning thread writes, so load + store is enough (no locked RMW).
+inline void bump(Counter& c, uint64_t d) {
+    c.store(c.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+}
+
+template<size_t N>
+int bucket_of(const double (&bounds)[N], double s) {
+    int b = 0;
+    while (b < (int)N && s > bounds[b]) ++b;
+    return b;
+}
+
+template<size_t N>
+void write_histogram(std::ostream& os, const char* name, const std::string& labels,
+                     const double (&bounds)[N], const uint64_t* buckets, uint64_t sum_ns) {
+    uint64_t cum = 0;
+    for (size_t b = 0; b < N; ++b) {
+        cum += buckets[b];
+        os << name << "_bucket{" << labels << ",le=\"" << bounds[b] << "\"} " << cum << "\n";
+    }
+    cum += buckets[N];
+    os << name << "_bucket{" << labels << ",le=\"+Inf\"} " << cum << "\n";
+    os << name << "_sum{" << labels << "} " << (double)sum_ns / 1e9 << "\n";
+    os << name << "_count{" << labels << "} " << cum << "\n";
+}
+
+} // namespace
+
+void metrics_enable() { g_enabled = true; }
+bool metrics_enabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+void metrics_record_image(FailureReason fr, double ms) {
+    if (!metrics_enabled()) return;
+    const int r = (int)fr;
+    if (r < 0 || r >= kFailureReasonCount) return;
+    ThreadBlock& b = local_block();
+    bump(b.image[r][bucket_of(kImageBounds, ms / 1e3)], 1);
+    bump(b.image_ns[r], (uint64_t)(ms * 1e6));
+}
+
+void metrics_record_stage(Stage s, long long ns) {
+    if (!metrics_enabled() || ns < 0) return;
+    ThreadBlock& b = local_block();
+    bump(b.stage[(int)s][bucket_of(kStageBounds, (double)ns / 1e9)], 1);
+    bump(b.stage_ns[(int)s], (uint64_t)ns);
+}
+
+void metrics_add_pixels(size_t pixels) {
+    if (!metrics_enabled()) return;
+    bump(local_block().pixels, pixels);
+}
+
+void metrics_write(std::ostream& os) {
+    uint64_t image[kFailureReasonCount][kImageBuckets] = {}, image_ns[kFailureReasonCount] = {};
+    uint64_t stage[kStages][kStageBuckets] = {}, stage_ns[kStages] = {};
+    uint64_t pixels = 0;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for (const auto& blk : g_blocks) {
+            for (int r = 0; r < kFailureReasonCount; ++r) {
+                for (int i = 0; i < kImageBuckets; ++i) image[r][i] += blk->image[r][i].load(std::memory_order_relaxed);
+                image_ns[r] += blk->image_ns[r].load(std::memory_order_relaxed);
+            }
+            for (int s = 0; s < kStages; ++s) {
+                for (int i = 0; i < kStageBuckets; ++i) stage[s][i] += blk->stage[s][i].load(std::memory_order_relaxed);
+                stage_ns[s] += blk->stage_ns[s].load(std::memory_order_relaxed);
+            }
+            pixels += blk->pixels.load(std::memory_order_relaxed);
+        }
+    }
+
+    const std::streamsize prec = os.precision(15);   // sums grow large over a long run
+    os << "# HELP marker_images_total Images processed, by outcome (OK or the FailureReason).\n"
+       << "# TYPE marker_images_total counter\n";
+    for (int r = 0; r < kFailureReasonCount; ++r) {
+        uint64_t n = 0;
+        for (int i = 0; i < kImageBuckets; ++i) n += image[r][i];
+        os << "marker_images_total{outcome=\"" << fr_to_cstr((FailureReason)r) << "\"} " << n << "\n";
+    }
+    os << "# HELP marker_image_duration_seconds Per-image latency, by outcome.\n"
+       << "# TYPE marker_image_duration_seconds histogram\n";
+    for (int r = 0; r < kFailureReasonCount; ++r)
+        write_histogram(os, "marker_image_duration_seconds",
+                        std::string("outcome=\"") + fr_to_cstr((FailureReason)r) + "\"",
+                        kImageBounds, image[r], image_ns[r]);
+    os << "# HELP marker_stage_duration_seconds Pipeline stage durations.\n"
+       << "# TYPE marker_stage_duration_seconds histogram\n";
+    for (int s = 0; s < kStages; ++s)
+        write_histogram(os, "marker_stage_duration_seconds",
+                        std::string("stage=\"") + stage_name((Stage)s) + "\"",
+                        kStageBounds, stage[s], stage_ns[s]);
+    os << "# HELP marker_pixels_total Pixels segmented.\n"
+       << "# TYPE marker_pixels_total counter\n"
+       << "marker_pixels_total " << pixels << "\n";
+    os << "# HELP marker_start_time_seconds Start of this process (Unix time), to spot restarts.\n"
+       << "# TYPE marker_start_time_seconds gauge\n"
+       << "marker_start_time_seconds " << std::fixed << std::setprecision(3) << g_start_s << "\n";
+    os.unsetf(std::ios::floatfield);
+    os.precision(prec);
+}
+
+MetricsExporter::MetricsExporter(const std::string& path, double interval_s)
+    : path_(path), interval_s_(interval_s > 0 ? interval_s : 15.0) {
+    metrics_enable();
+    worker_ = std::thread([this] { run(); });
+}
+
+MetricsExporter::~MetricsExporter() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    worker_.join();
+    write_now();   // the final counts of a finished run
+}
+
+bool MetricsExporter::write_now() {
+    const std::string tmp = path_ + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out) return false;
+        metrics_write(out);
+        out.flush();
+        if (!out) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path_, ec);   // atomic replace on POSIX
+    return !ec;
+}
+
+void MetricsExporter::run() {
+    bool warned = false;
+    std::unique_lock<std::mutex> lock(mu_);
+    while (!stop_) {
+        lock.unlock();
+        if (!write_now() && !warned) {
+            std::cerr << "[metrics] cannot write " << path_ << "\n";
+            warned = true;
+        }
+        lock.lock();
+        cv_.wait_for(lock, std::chrono::duration<double>(interval_s_), [this] { return stop_; });
+    }
+}
@@ -0,0 +1,155 @@
+#include "overlay_writer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+using namespace cv;
+
+// Drawing color per palette name (BGR); unknown names draw white.
+static Scalar patch_color(const std::string& name) {
+    if (name == "red")     return Scalar(0, 0, 255);
+    if (name == "green")   return Scalar(0, 200, 0);
+    if (name == "blue")    return Scalar(255, 64, 0);
+    if (name == "yellow")  return Scalar(0, 220, 220);
+    if (name == "cyan")    return Scalar(220, 220, 0);
+    if (name == "magenta") return Scalar(220, 0, 220);
+    return Scalar(255, 255, 255);
+}
+
+// "data/hi1.png" -> "data_hi1.png", "/scans/a/hi1.png" -> "scans_a_hi1.png",
+// "cam#12" -> "cam_12": one flat file per input, named by its whole path so
+// same-named files from different directories do not overwrite each other.
+static std::string overlay_file_name(const std::string& name) {
+    size_t i = 0;   // leading separators and "./" say nothing about the file
+    for (;;) {
+        if (i < name.size() && (name[i] == '/' || name[i] == '\\')) ++i;
+        else if (name.compare(i, 2, "./") == 0 || name.compare(i, 2, ".\\") == 0) i += 2;
+        else break;
+    }
+    std::string flat = name.substr(i);
+    for (char& c : flat) if (c == '/' || c == '\\' || c == '#' || c == ':' || c == ' ') c = '_';
+    return flat + ".overlay.png";
+}
+
+OverlayWriter::OverlayWriter(const OverlayParams& p) : p_(p) {
+    if (p_.every < 1) p_.every = 1;
+    if (p_.queue < 1) p_.queue = 1;
+    worker_ = std::thread([this] { run(); });
+}
+
+OverlayWriter::~OverlayWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    worker_.join();
+}
+
+bool OverlayWriter::wants(size_t index, bool ok) const {
+    if (p_.failures_only && ok) return false;
+    return index % (size_t)p_.every == 0;
+}
+
+bool OverlayWriter::submit_file(const std::string& path, const ImageResult& res) {
+    Job job;
+    job.name = path;
+    job.from_file = true;
+    job.res = res;
+    return push(std::move(job));
+}
+
+bool OverlayWriter::submit_frame(const std::string& name, const cv::Mat& bgr, const ImageResult& res) {
+    {
+        // don't pay for the copy when it would be dropped anyway
+        std::lock_guard<std::mutex> lock(mu_);
+        if (q_.size() >= p_.queue) { ++dropped_; return false; }
+    }
+    Job job;
+    job.name = name;
+    job.bgr = bgr.clone();
+    job.res = res;
+    return push(std::move(job));
+}
+
+bool OverlayWriter::push(Job&& job) {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (q_.size() >= p_.queue) { ++dropped_; return false; }
+        q_.push_back(std::move(job));
+    }
+    cv_.notify_one();
+    return true;
+}
+
+size_t OverlayWriter::written() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return written_;
+}
+
+size_t OverlayWriter::dropped() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return dropped_;
+}
+
+void OverlayWriter::run() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mu_);
+            cv_.wait(lock, [this] { return stop_ || !q_.empty(); });
+            if (q_.empty()) return;   // stop_ and drained
+            job = std::move(q_.front());
+            q_.pop_front();
+        }
+        render_and_write(job);
+    }
+}
+
+void OverlayWriter::render_and_write(Job& job) {
+    if (job.from_file) job.bgr = imread(job.name, IMREAD_COLOR);
+    if (job.bgr.empty()) return;
+
+    // Markers are often tiny: scale so the longest side is p_.side. Results
+    // of the half-resolution fallback are drawn back at full size.
+    const double img_scale = (double)p_.side / (double)std::max(job.bgr.cols, job.bgr.rows);
+    const double scale = img_scale / job.res.coord_scale;
+    Mat canvas;
+    resize(job.bgr, canvas, Size(), img_scale, img_scale, img_scale >= 1.0 ? INTER_NEAREST : INTER_AREA);
+    auto sc = [scale](const Rect& r) {
+        return Rect((int)std::lround(r.x * scale), (int)std::lround(r.y * scale),
+                    (int)std::lround(r.width * scale), (int)std::lround(r.height * scale));
+    };
+    auto sp = [scale](const Point2f& p) { return Point((int)std::lround(p.x * scale), (int)std::lround(p.y * scale)); };
+
+    // every candidate: thin box in its palette color
+    for (const Patch& p : job.res.patches) rectangle(canvas, sc(p.box), patch_color(p.color), 1, LINE_AA);
+
+    // grids: assigned cells with their (row,col), hull green when accepted.
+    // Cache and journal hits keep coverage only: no cells, no hull.
+    for (const MarkerResult& m : job.res.markers) {
+        for (int r = 0; r < 3; ++r) for (int c = 0; c < 3; ++c) {
+            const Patch& p = m.gd.grid[r][c];
+            if (p.box.area() <= 0) continue;   // cell not assigned
+            rectangle(canvas, sc(p.box), patch_color(p.color), 2, LINE_AA);
+            putText(canvas, std::to_string(r) + "," + std::to_string(c), sp(p.center),
+                    FONT_HERSHEY_SIMPLEX, 0.4, Scalar(255, 255, 255), 1, LINE_AA);
+        }
+        std::vector<Point> hull;
+        for (const Point2f& h : m.cov.hull) hull.push_back(sp(h));
+        if (!hull.empty())
+            polylines(canvas, hull, true, m.ok ? Scalar(0, 255, 0) : Scalar(0, 0, 255), 2, LINE_AA);
+    }
+
+    std::string label = job.res.ok ? "ok" : fr_to_cstr(job.res.fr);
+    if (job.res.ok) label += " " + std::to_string((int)std::lround(job.res.markers.front().cov.ratio * 100.0)) + "%";
+    label += "  patches=" + std::to_string(job.res.patch_count);
+    putText(canvas, label, Point(6, 18), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(0, 0, 0), 3, LINE_AA);
+    putText(canvas, label, Point(6, 18), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(255, 255, 255), 1, LINE_AA);
+
+    const std::string out = p_.dir + "/" + overlay_file_name(job.name);
+    bool ok = false;
+    try { ok = imwrite(out, canvas); } catch (const cv::Exception&) {}
+    if (!ok) { std::cerr << "[overlay] cannot write " << out << "\n"; return; }
+    std::lock_guard<std::mutex> lock(mu_);
+    ++written_;
+}
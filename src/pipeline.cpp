@@ -0,0 +1,241 @@
+#include "pipeline.hpp"
+#include "prefilter.hpp"
+#include "stage_profiler.hpp"
+#include "strip_segmentation.hpp"
+#include "mem_stats.hpp"
+#include "frame_arena.hpp"
+#include <algorithm>
+#include <optional>
+
+// Share of the remaining budget full-resolution segmentation may use before
+// the pipeline falls back to a half-resolution pass.
+static const double kFullResShare = 0.6;
+
+// Failures of the candidate set itself, which the staged retry may recover.
+// Spacing and coverage verdicts already have their fallbacks (grid_accepted).
+static bool retryable(FailureReason fr) {
+    return fr == FailureReason::FEW_PATCHES || fr == FailureReason::ASSIGN_GRID ||
+           fr == FailureReason::FEW_COLORS || fr == FailureReason::FEW_COMPATIBLE ||
+           fr == FailureReason::SMALL_SPREAD;
+}
+
+bool grid_accepted(bool spacing_ok, float cvx, float cvy, double coverage_ratio, const GridParams& params) {
+    if (!spacing_ok && coverage_ratio >= params.coverage_fallback) spacing_ok = true;
+    if (!spacing_ok && cvx <= 0.60f && cvy <= 0.70f && coverage_ratio >= params.coverage_soft) spacing_ok = true;
+    return spacing_ok && coverage_ratio >= params.coverage_thresh;
+}
+
+MarkerResult evaluate_grid(const GridDetection& gd, const cv::Size& img_size, const GridParams& params) {
+    MarkerResult m;
+    m.gd = gd;
+    m.cov = compute_coverage_from_grid(gd.grid, img_size);
+    if (m.cov.hull_area <= 0.0 || m.cov.image_area <= 0.0) {
+        m.fr = FailureReason::BAD_BBOX;
+        return m;
+    }
+
+    m.ok = grid_accepted(gd.spacing_ok, gd.cvx, gd.cvy, m.cov.ratio, params);
+    m.fr = m.ok ? FailureReason::NONE : FailureReason::LOW_COVERAGE;
+    return m;
+}
+
+SegmentationParams default_segmentation_params() {
+    return SegmentationParams();
+}
+
+GridParams default_grid_params() {
+    GridParams gp;
+    // thresholds as in your tuned logic
+    gp.coverage_thresh = 0.45f; // must-have
+    gp.coverage_fallback = 0.55f; // accept even if spacing failed
+    gp.coverage_soft = 0.50f; // soft acceptance if cv within near-range
+    return gp;
+}
+
+const char* retry_stage_name(RetryStage s) {
+    switch (s) {
+    case RetryStage::RelaxedArea:  return "relaxed_area";
+    case RetryStage::WidenedBands: return "widened_bands";
+    default:                       return "none";
+    }
+}
+
+// Steps 2-4, shared by the whole-image and strip entry points.
+static ImageResult evaluate_patches(std::vector<Patch> candidates, const cv::Size& img_size,
+                                    const GridParams& gp, bool multi, const Deadline* dl) {
+    ImageResult res;
+    res.patches = std::move(candidates);
+    const std::vector<Patch>& patches = res.patches;
+    MemCharge patch_mem(patches.capacity() * sizeof(Patch));
+    res.patch_count = patches.size();
+    if (patches.size() < 3) { res.fr = FailureReason::FEW_PATCHES; return res; }
+
+    // 2a) Cheap geometric pre-checks: hopeless candidate sets skip clustering
+    const FailureReason pre = precheck_candidates(patches, img_size, gp);
+    if (pre != FailureReason::NONE) { res.fr = pre; return res; }
+
+    // 2) Grid detection + spacing validation (PCA-rotated coords, CV thresholds)
+    std::vector<GridDetection> grids(1);
+    FailureReason fr = multi ? detect_all_grids(patches, grids, gp, dl)
+                             : detect_grid_and_spacing(patches, grids[0], gp, dl);
+    if (fr != FailureReason::NONE) { res.fr = fr; return res; }
+
+    // 3+4) Coverage and thresholds, per grid
+    for (const auto& gd : grids) res.markers.push_back(evaluate_grid(gd, img_size, gp));
+    std::stable_partition(res.markers.begin(), res.markers.end(), [](const MarkerResult& m){ return m.ok; });
+    res.ok = res.markers.front().ok;
+    res.fr = res.markers.front().fr;
+    return res;
+}
+
+static ImageResult process_image_run(const cv::Mat& bgr,
+                                     const SegmentationParams& segp,
+                                     const GridParams& gp,
+                                     bool multi,
+                                     const Deadline* dl) {
+    ImageResult res;
+
+    // 0) Thumbnail pre-rejection: most no-marker frames stop here
+    if (!prefilter_may_contain_marker(bgr, segp, gp.coverage_thresh)) {
+        res.fr = FailureReason::FEW_PATCHES;
+        return res;
+    }
+
+    // Over a memory budget that even one-color-at-a-time cannot meet, segment
+    // the decoded image in strips instead of building image-sized copies.
+    if (segp.mem_budget > 0) {
+        const MemPlan plan = plan_memory(bgr.size(), segp.mem_budget);
+        if (plan.strategy == MemStrategy::Strips) {
+            auto src = strip_source_from_mat(bgr);
+            return process_image_strips(*src, segp, gp, plan.strip_rows, multi, dl);
+        }
+    }
+
+    // 1) Color segmentation -> candidate patches. For the staged retry the
+    // pass is kept: its HSV image stays in this scope's arena, and contours
+    // are traced down to the relaxed area bounds.
+    stage_profiler_add_pixels(bgr.total());
+    const Deadline full = dl ? dl->slice(kFullResShare) : Deadline();
+    cv::Size img_size = bgr.size();
+    const bool retry = segp.retry_area_scale > 0;
+    std::optional<ArenaScope> keep;
+    KeptPass pass;
+    std::vector<Patch> patches;
+    if (retry) {
+        keep.emplace();
+        segment_color_patches_keep(bgr, segp, pass, dl ? &full : nullptr);
+        patches = filter_patches_by_area(pass.patches, img_size, segp.min_area_ratio, segp.max_area_ratio);
+    }
+    else patches = segment_color_patches(bgr, segp, dl ? &full : nullptr);
+    if (full.tripped()) {
+        // Degrade: ratios are relative to image area, so half resolution
+        // yields the same decision at a quarter of the pixel cost.
+        dl->mark_degraded();
+        if (dl->expired() || std::min(bgr.cols, bgr.rows) < 64) { res.fr = FailureReason::TIMEOUT; return res; }
+        cv::Mat small;
+        cv::resize(bgr, small, cv::Size(), 0.5, 0.5, cv::INTER_AREA);
+        stage_profiler_add_pixels(small.total());
+        img_size = small.size();
+        patches = segment_color_patches(small, segp, dl);
+        if (dl->tripped()) { res.fr = FailureReason::TIMEOUT; return res; }
+        res = evaluate_patches(std::move(patches), img_size, gp, multi, dl);
+        res.coord_scale = 0.5;
+        return res;
+    }
+    res = evaluate_patches(std::move(patches), img_size, gp, multi, dl);
+    if (!retry || !retryable(res.fr)) return res;
+
+    // Staged retry, cheapest first; the first accepted result wins, otherwise
+    // the first attempt's failure stands.
+    // a) the same contours under relaxed area bounds (no pixel work)
+    const double s = std::max(1.0, segp.retry_area_scale);
+    std::vector<Patch> relaxed = filter_patches_by_area(pass.patches, img_size,
+                                                        segp.min_area_ratio / s, segp.max_area_ratio * s);
+    if (relaxed.size() > res.patch_count && !(dl && dl->expired())) {
+        ImageResult r = evaluate_patches(std::move(relaxed), img_size, gp, multi, dl);
+        if (r.ok) { r.retry = RetryStage::RelaxedArea; return r; }
+    }
+    // b) the kept HSV image re-thresholded with widened bands
+    if (dl && dl->expired()) return res;
+    ImageResult r = evaluate_patches(segment_widened(pass, segp, dl), img_size, gp, multi, dl);
+    if (r.ok) { r.retry = RetryStage::WidenedBands; return r; }
+    return res;
+}
+
+static ImageResult process_image_yuv_run(const YuvPlanes& frame,
+                                         const SegmentationParams& segp,
+                                         const GridParams& gp,
+                                         bool multi,
+                                         const Deadline* dl) {
+    if (!prefilter_may_contain_marker_yuv(frame, segp, gp.coverage_thresh)) {
+        ImageResult res;
+        res.fr = FailureReason::FEW_PATCHES;
+        return res;
+    }
+    stage_profiler_add_pixels((size_t)frame.size().area());
+    auto patches = segment_color_patches_yuv(frame, segp, dl);
+    if (dl && dl->tripped()) { ImageResult res; res.fr = FailureReason::TIMEOUT; return res; }
+    return evaluate_patches(std::move(patches), frame.size(), gp, multi, dl);
+}
+
+static ImageResult process_image_strips_run(StripSource& src,
+                                            const SegmentationParams& segp,
+                                            const GridParams& gp,
+                                            int strip_rows,
+                                            bool multi,
+                                            const Deadline* dl) {
+    // No thumbnail pre-rejection here: building it would need the whole image.
+    auto patches = segment_color_patches_strips(src, segp, strip_rows, dl);
+    if (dl && dl->tripped()) { ImageResult res; res.fr = FailureReason::TIMEOUT; return res; }
+    return evaluate_patches(std::move(patches), cv::Size(src.width(), src.height()), gp, multi, dl);
+}
+
+// The public entry points: the run, plus whether the deadline cut it short.
+// The arena's first block outlives the image; under --mem-budget it may not
+// stay larger than the budget.
+ImageResult process_image(const cv::Mat& bgr, const SegmentationParams& segp, const GridParams& gp,
+                          bool multi, const Deadline* dl) {
+    FrameArena::local().set_block_limit(segp.mem_budget);
+    ImageResult res = process_image_run(bgr, segp, gp, multi, dl);
+    res.degraded = dl && dl->degraded();
+    return res;
+}
+
+ImageResult process_image_yuv(const YuvPlanes& frame, const SegmentationParams& segp, const GridParams& gp,
+                              bool multi, const Deadline* dl) {
+    FrameArena::local().set_block_limit(segp.mem_budget);
+    ImageResult res = process_image_yuv_run(frame, segp, gp, multi, dl);
+    res.degraded = dl && dl->degraded();
+    return res;
+}
+
+ImageResult process_image_strips(StripSource& src, const SegmentationParams& segp, const GridParams& gp,
+                                 int strip_rows, bool multi, const Deadline* dl) {
+    FrameArena::local().set_block_limit(segp.mem_budget);
+    ImageResult res = process_image_strips_run(src, segp, gp, strip_rows, multi, dl);
+    res.degraded = dl && dl->degraded();
+    return res;
+}
+
+std::vector<ImageResult> process_batch(const FrameBatch& batch,
+                                       const SegmentationParams& segp,
+                                       const GridParams& gp,
+                                       bool multi) {
+    std::vector<ImageResult> out(batch.size());
+    std::vector<bool> active(batch.size(), true);
+    size_t n_active = 0;
+    for (int i = 0; i < batch.size(); ++i) {
+        active[i] = prefilter_may_contain_marker(batch.frame(i), segp, gp.coverage_thresh);
+        if (active[i]) ++n_active;
+        else out[i].fr = FailureReason::FEW_PATCHES;
+    }
+    if (n_active == 0) return out;
+
+    // Rejected frames still ride through the batched passes; only their
+    // contour tracing and grid search are skipped.
+    stage_profiler_add_pixels((size_t)batch.frame_size().area() * (size_t)batch.size());
+    auto patches = segment_color_patches_batch(batch, segp, active);
+    for (int i = 0; i < batch.size(); ++i)
+        if (active[i]) out[i] = evaluate_patches(std::move(patches[i]), batch.frame_size(), gp, multi, nullptr);
+    return out;
+}
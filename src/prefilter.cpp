@@ -0,0 +1,93 @@
+#include "prefilter.hpp"
+#include "palette.hpp"
+#include "yuv_classify.hpp"
+using namespace cv;
+
+// Thumbnail size for an image of the given size (the size itself if small enough).
+static Size thumb_size(Size img, int max_side) {
+    const int side = std::max(img.width, img.height);
+    if (side <= max_side) return img;
+    double s = (double)max_side / (double)side;
+    return Size(std::max(1, (int)std::lround(img.width * s)), std::max(1, (int)std::lround(img.height * s)));
+}
+
+template<class P>
+bool prefilter_passes_t(const PrefilterCounts<P>& tc, const SegmentationParams& params, float coverage_thresh) {
+    if (tc.pixels <= 0) return true;
+    const double n = (double)tc.pixels;
+    int present = 0;
+    for (int c = 0; c < P::kColors; ++c)
+        if (tc.per_color[c] >= params.prefilter_color_frac * n) ++present;
+
+    return present >= params.prefilter_min_colors &&
+           tc.colored >= params.prefilter_fill * coverage_thresh * n;
+}
+
+template<class P>
+PrefilterCounts<P> prefilter_counts_t(const cv::Mat& bgr, const SegmentationParams& params) {
+    PrefilterCounts<P> tc;
+    if (params.prefilter_side <= 0 || bgr.empty()) return tc;
+
+    Mat thumb;
+    const Size ts = thumb_size(bgr.size(), params.prefilter_side);
+    if (ts != bgr.size()) resize(bgr, thumb, ts, 0, 0, INTER_AREA);
+    else thumb = bgr;
+
+    Mat hsv; cvtColor(thumb, hsv, COLOR_BGR2HSV);
+
+    for (int y = 0; y < hsv.rows; ++y) {
+        const uchar* p = hsv.ptr<uchar>(y);
+        for (int x = 0; x < hsv.cols; ++x, p += 3) tc.add(classify_hsv<P>(p[0], p[1], p[2]));
+    }
+    tc.pixels = (int)hsv.total();
+    return tc;
+}
+
+template<class P>
+bool prefilter_may_contain_marker_t(const cv::Mat& bgr, const SegmentationParams& params, float coverage_thresh) {
+    return prefilter_passes_t(prefilter_counts_t<P>(bgr, params), params, coverage_thresh);
+}
+
+template PrefilterCounts<SixColorPalette> prefilter_counts_t<SixColorPalette>(const cv::Mat&, const SegmentationParams&);
+template bool prefilter_passes_t<SixColorPalette>(const PrefilterCounts<SixColorPalette>&, const SegmentationParams&, float);
+template bool prefilter_may_contain_marker_t<SixColorPalette>(const cv::Mat&, const SegmentationParams&, float);
+
+bool prefilter_may_contain_marker(const cv::Mat& bgr, const SegmentationParams& params, float coverage_thresh) {
+    return prefilter_may_contain_marker_t<DefaultPalette>(bgr, params, coverage_thresh);
+}
+
+template<class P>
+bool prefilter_may_contain_marker_yuv_t(const YuvPlanes& frame, const SegmentationParams& params, float coverage_thresh) {
+    if (params.prefilter_side <= 0 || frame.y.empty()) return true;
+
+    const Size ts = thumb_size(frame.size(), params.prefilter_side);
+    Mat ty, tu, tv;
+    resize(frame.y, ty, ts, 0, 0, INTER_AREA);
+    if (frame.format == YuvFormat::NV12) {
+        Mat tuv, ch[2];
+        resize(frame.uv, tuv, ts, 0, 0, INTER_AREA);
+        split(tuv, ch);
+        tu = ch[0]; tv = ch[1];
+    }
+    else {
+        resize(frame.u, tu, ts, 0, 0, INTER_AREA);
+        resize(frame.v, tv, ts, 0, 0, INTER_AREA);
+    }
+
+    const YuvLut& lut = yuv_lut<P>();
+    PrefilterCounts<P> tc;
+    for (int y = 0; y < ts.height; ++y) {
+        const uchar* py = ty.ptr<uchar>(y);
+        const uchar* pu = tu.ptr<uchar>(y);
+        const uchar* pv = tv.ptr<uchar>(y);
+        for (int x = 0; x < ts.width; ++x) tc.add(lut.classify(py[x], pu[x], pv[x]));
+    }
+    tc.pixels = ts.area();
+    return prefilter_passes_t(tc, params, coverage_thresh);
+}
+
+template bool prefilter_may_contain_marker_yuv_t<SixColorPalette>(const YuvPlanes&, const SegmentationParams&, float);
+
+bool prefilter_may_contain_marker_yuv(const YuvPlanes& frame, const SegmentationParams& params, float coverage_thresh) {
+    return prefilter_may_contain_marker_yuv_t<DefaultPalette>(frame, params, coverage_thresh);
+}
@@ -0,0 +1,153 @@
+#include "result_cache.hpp"
+#include "hash.hpp"
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+
+static const char     kMagic[8]      = { 'M','K','C','A','C','H','E','\0' };
+static const uint32_t kCacheVersion  = 1; // bump when the algorithm output changes
+static const size_t   kHeaderSize    = 16;
+static_assert(sizeof(CacheRecord) % 8 == 0, "records must keep 8-byte alignment");
+
+static uint64_t bits(float f)  { uint32_t u; std::memcpy(&u, &f, 4); return u; }
+static uint64_t bits(double d) { uint64_t u; std::memcpy(&u, &d, 8); return u; }
+
+uint64_t cache_params_hash(const SegmentationParams& segp, const GridParams& gp, bool multi) {
+    uint64_t h = hash_mix64(kCacheVersion);
+    h = hash_combine(h, bits(segp.min_area_ratio));
+    h = hash_combine(h, bits(segp.max_area_ratio));
+    h = hash_combine(h, (uint64_t)segp.prefilter_side);
+    h = hash_combine(h, bits(segp.prefilter_color_frac));
+    h = hash_combine(h, (uint64_t)segp.prefilter_min_colors);
+    h = hash_combine(h, bits(segp.prefilter_fill));
+    h = hash_combine(h, bits(gp.cvx_thresh));
+    h = hash_combine(h, bits(gp.cvy_thresh));
+    h = hash_combine(h, bits(gp.coverage_thresh));
+    h = hash_combine(h, bits(gp.coverage_fallback));
+    h = hash_combine(h, bits(gp.coverage_soft));
+    h = hash_combine(h, bits(gp.group_link));
+    h = hash_combine(h, (uint64_t)gp.min_colors);
+    h = hash_combine(h, bits(gp.area_compat));
+    h = hash_combine(h, multi ? 1u : 0u);
+    if (segp.retry_area_scale > 0) h = hash_combine(h, bits(segp.retry_area_scale));   // off: old caches stay valid
+    return h;
+}
+
+bool ResultCache::open(const std::string& path, uint64_t params_hash) {
+    path_ = path;
+    params_hash_ = params_hash;
+    index_.clear(); added_.clear(); flushed_ = 0;
+
+    if (!map_.open(path) || map_.size() < kHeaderSize) {
+        // missing / truncated: start a fresh file
+        std::ofstream f(path, std::ios::binary | std::ios::trunc);
+        if (!f) return false;
+        uint32_t hdr[2] = { kCacheVersion, (uint32_t)sizeof(CacheRecord) };
+        f.write(kMagic, 8);
+        f.write(reinterpret_cast<const char*>(hdr), sizeof(hdr));
+        return (bool)f;
+    }
+
+    const unsigned char* p = map_.data();
+    uint32_t hdr[2]; std::memcpy(hdr, p + 8, sizeof(hdr));
+    if (std::memcmp(p, kMagic, 8) != 0 || hdr[0] != kCacheVersion || hdr[1] != sizeof(CacheRecord)) {
+        map_.close();
+        std::remove(path.c_str());
+        return open(path, params_hash);
+    }
+
+    // A torn trailing record (killed mid-append) is cut off, so that flush()
+    // appends at a record boundary. Records are 8-byte multiples after a
+    // 16-byte header, so they stay aligned.
+    size_t n = (map_.size() - kHeaderSize) / sizeof(CacheRecord);
+    const size_t valid_end = kHeaderSize + n * sizeof(CacheRecord);
+    if (valid_end < map_.size()) {
+        std::error_code ec;
+        std::filesystem::resize_file(path, valid_end, ec);
+        if (ec) { map_.close(); return false; }
+    }
+    const CacheRecord* recs = reinterpret_cast<const CacheRecord*>(p + kHeaderSize);
+    index_.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (recs[i].params_hash != params_hash_) continue;
+        index_[recs[i].content_hash] = &recs[i];
+    }
+    return true;
+}
+
+// Markers make_cache_record() keeps, before the kMaxMarkers cut.
+static size_t recorded_markers(const ImageResult& res) {
+    size_t n = 0;
+    for (const auto& m : res.markers) {
+        if (n > 0 && !m.ok) break;
+        ++n;
+    }
+    return n;
+}
+
+bool cache_record_fits(const ImageResult& res) {
+    return recorded_markers(res) <= (size_t)ResultCache::kMaxMarkers;
+}
+
+CacheRecord make_cache_record(const ImageResult& res) {
+    CacheRecord r{};
+    r.ok = res.ok ? 1 : 0;
+    r.fr = (uint8_t)res.fr;
+    // a failed image keeps only the primary marker (for the debug stats line)
+    int n = 0;
+    for (const auto& m : res.markers) {
+        if (n == ResultCache::kMaxMarkers || (n > 0 && !m.ok)) break;
+        r.ratio[n] = (float)m.cov.ratio;
+        r.hull_area[n] = (float)m.cov.hull_area;
+        r.image_area = m.cov.image_area;
+        ++n;
+    }
+    r.n_markers = (uint8_t)n;
+    if (!res.markers.empty()) { r.cvx = res.markers[0].gd.cvx; r.cvy = res.markers[0].gd.cvy; }
+    return r;
+}
+
+ImageResult result_from_record(const CacheRecord& r) {
+    ImageResult out;
+    out.ok = r.ok != 0;
+    out.fr = (FailureReason)r.fr;
+    for (int k = 0; k < (int)r.n_markers && k < ResultCache::kMaxMarkers; ++k) {
+        MarkerResult m;
+        m.ok = out.ok;
+        m.fr = out.fr;
+        m.cov.ratio = r.ratio[k];
+        m.cov.hull_area = r.hull_area[k];
+        m.cov.image_area = r.image_area;
+        if (k == 0) { m.gd.cvx = r.cvx; m.gd.cvy = r.cvy; }
+        out.markers.push_back(std::move(m));
+    }
+    return out;
+}
+
+bool ResultCache::lookup(uint64_t content_hash, ImageResult& out) const {
+    auto it = index_.find(content_hash);
+    if (it == index_.end()) return false;
+    out = result_from_record(*it->second);
+    ++hits_;
+    return true;
+}
+
+void ResultCache::store(uint64_t content_hash, const ImageResult& res) {
+    if (!cache_record_fits(res)) return;   // a hit would report fewer markers
+    CacheRecord r = make_cache_record(res);
+    r.content_hash = content_hash;
+    r.params_hash = params_hash_;
+    added_.push_back(r);
+    index_[content_hash] = &added_.back();
+}
+
+bool ResultCache::flush() {
+    if (flushed_ == added_.size()) return true;
+    std::ofstream f(path_, std::ios::binary | std::ios::app);
+    if (!f) return false;
+    for (; flushed_ < added_.size(); ++flushed_)
+        f.write(reinterpret_cast<const char*>(&added_[flushed_]), sizeof(CacheRecord));
+    return (bool)f;
+}
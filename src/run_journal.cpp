@@ -0,0 +1,163 @@
+#include "run_journal.hpp"
+#include "hash.hpp"
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <io.h>
+static int sync_file(std::FILE* f) { return _commit(_fileno(f)); }
+#else
+#include <unistd.h>
+static int sync_file(std::FILE* f) { return fsync(fileno(f)); }
+#endif
+
+static const char     kJournalMagic[8] = { 'M','K','J','R','N','L','1','\0' };
+static const uint32_t kJournalVersion  = 2;   // 2: input stamp
+
+struct JournalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;       // sizeof(RecordHead), catches layout changes
+    uint64_t params_hash;
+};
+struct RecordHead {
+    uint64_t name_hash;
+    uint64_t stamp;             // input_stamp() or pack content hash at the time of the run
+    uint32_t name_len;
+    uint32_t peak_kb;
+    float    ms;
+    uint32_t check;             // low half of hash64(result + name)
+    CacheRecord result;
+};
+static_assert(sizeof(JournalHeader) == 24, "journal layout");
+static_assert(sizeof(RecordHead) == 104, "journal layout");
+
+static uint32_t record_check(const RecordHead& h, const char* name) {
+    return (uint32_t)hash64(name, h.name_len, hash64(&h.result, sizeof(h.result), hash_combine(h.name_hash, h.stamp)));
+}
+
+uint64_t input_stamp(const std::string& path) {
+    std::error_code ec_time, ec_size;
+    const auto mtime = std::filesystem::last_write_time(path, ec_time);
+    const uintmax_t size = std::filesystem::file_size(path, ec_size);
+    if (ec_time || ec_size) return 0;
+    return hash_combine(hash_mix64((uint64_t)size), (uint64_t)mtime.time_since_epoch().count());
+}
+
+bool RunJournal::open(const std::string& path, uint64_t params_hash, bool& params_mismatch) {
+    close();
+    params_mismatch = false;
+    size_t valid_end = 0;
+    if (map_.open(path) && map_.size() >= sizeof(JournalHeader)) {
+        JournalHeader h;
+        std::memcpy(&h, map_.data(), sizeof(h));
+        if (std::memcmp(h.magic, kJournalMagic, 8) != 0 || h.version != kJournalVersion ||
+            h.record_size != sizeof(RecordHead)) {
+            map_.close();
+            return false;       // not ours: never overwrite it
+        }
+        if (h.params_hash != params_hash) { map_.close(); params_mismatch = true; return false; }
+
+        // Walk the records; the first torn or corrupt one ends the valid part.
+        size_t off = sizeof(JournalHeader);
+        while (map_.size() - off >= sizeof(RecordHead)) {
+            RecordHead rh;
+            std::memcpy(&rh, map_.data() + off, sizeof(rh));
+            const char* name = reinterpret_cast<const char*>(map_.data() + off + sizeof(rh));
+            if (rh.name_len > map_.size() - off - sizeof(rh) ||
+                rh.check != record_check(rh, name) || rh.name_hash != hash64(name, rh.name_len))
+                break;
+            index_[rh.name_hash] = off;
+            off += sizeof(rh) + rh.name_len;
+        }
+        valid_end = off;
+    }
+    else if (map_.is_open() && map_.size() > 0) {
+        map_.close();
+        return false;           // shorter than a header: not a journal
+    }
+
+    if (valid_end == 0) {
+        map_.close();
+        f_ = std::fopen(path.c_str(), "wb");
+        if (!f_) return false;
+        JournalHeader h{};
+        std::memcpy(h.magic, kJournalMagic, 8);
+        h.version = kJournalVersion;
+        h.record_size = sizeof(RecordHead);
+        h.params_hash = params_hash;
+        if (std::fwrite(&h, sizeof(h), 1, f_) != 1 || !sync()) { close(); return false; }
+    }
+    else {
+        std::error_code ec;
+        if (valid_end < map_.size()) std::filesystem::resize_file(path, valid_end, ec);
+        if (ec) { close(); return false; }
+        f_ = std::fopen(path.c_str(), "ab");
+        if (!f_) { close(); return false; }
+    }
+    last_sync_ = std::chrono::steady_clock::now();
+    return true;
+}
+
+void RunJournal::close() {
+    if (f_) {
+        sync();
+        std::fclose(f_);
+        f_ = nullptr;
+    }
+    map_.close();
+    index_.clear();
+    unsynced_ = 0;
+}
+
+size_t RunJournal::find(const std::string& name, uint64_t stamp) const {
+    auto it = index_.find(hash64(name.data(), name.size()));
+    if (it == index_.end()) return kNone;
+    uint32_t len;
+    uint64_t recorded;
+    std::memcpy(&len, map_.data() + it->second + offsetof(RecordHead, name_len), sizeof(len));
+    std::memcpy(&recorded, map_.data() + it->second + offsetof(RecordHead, stamp), sizeof(recorded));
+    if (len != name.size() || std::memcmp(map_.data() + it->second + sizeof(RecordHead), name.data(), len) != 0)
+        return kNone;           // hash collision with another input
+    if (recorded != stamp) return kNone;   // the input changed since
+    return it->second;
+}
+
+bool RunJournal::lookup(const std::string& name, uint64_t stamp, JournalEntry& out) const {
+    const size_t off = find(name, stamp);
+    if (off == kNone) return false;
+    RecordHead rh;
+    std::memcpy(&rh, map_.data() + off, sizeof(rh));
+    out.res = result_from_record(rh.result);
+    out.ms = rh.ms;
+    out.peak_bytes = (size_t)rh.peak_kb * 1024;
+    return true;
+}
+
+bool RunJournal::append(const std::string& name, uint64_t stamp, const ImageResult& res, double ms, size_t peak_bytes) {
+    if (!f_) return false;
+    if (!cache_record_fits(res)) return true;   // not resumable: runs again after a restart
+    RecordHead rh{};
+    rh.name_hash = hash64(name.data(), name.size());
+    rh.stamp = stamp;
+    rh.name_len = (uint32_t)name.size();
+    rh.peak_kb = (uint32_t)((peak_bytes + 1023) / 1024);
+    rh.ms = (float)ms;
+    rh.result = make_cache_record(res);
+    rh.check = record_check(rh, name.data());
+    bool ok = std::fwrite(&rh, sizeof(rh), 1, f_) == 1 &&
+              std::fwrite(name.data(), 1, name.size(), f_) == name.size() &&
+              std::fflush(f_) == 0;   // in the kernel: survives the process being killed
+    if (++unsynced_ >= kJournalSyncRecords ||
+        std::chrono::steady_clock::now() - last_sync_ >= std::chrono::duration<double>(kJournalSyncSeconds))
+        ok = sync() && ok;
+    return ok;
+}
+
+bool RunJournal::sync() {
+    if (!f_) return false;
+    unsynced_ = 0;
+    last_sync_ = std::chrono::steady_clock::now();
+    return std::fflush(f_) == 0 && sync_file(f_) == 0;
+}
@@ -0,0 +1,89 @@
+#include "run_labeler.hpp"
+#include <algorithm>
+
+int RunLabeler::find(int i) {
+    while (blobs_[i].parent != i) { blobs_[i].parent = blobs_[blobs_[i].parent].parent; i = blobs_[i].parent; }
+    return i;
+}
+
+int RunLabeler::alloc(int y) {
+    int id;
+    if (!free_.empty()) { id = free_.back(); free_.pop_back(); }
+    else { id = (int)blobs_.size(); blobs_.emplace_back(); }
+    Node& n = blobs_[id];
+    n.b = Blob();
+    n.b.minx = n.b.miny = 1 << 30;
+    n.b.maxx = n.b.maxy = -1;
+    n.parent = id; n.seen = y; n.open = true;
+    return id;
+}
+
+void RunLabeler::unite(int a, int b) {
+    a = find(a); b = find(b);
+    if (a == b) return;
+    if (b < a) std::swap(a, b);
+    Blob& A = blobs_[a].b; const Blob& B = blobs_[b].b;
+    A.count += B.count; A.sx += B.sx; A.sy += B.sy;
+    A.minx = std::min(A.minx, B.minx); A.miny = std::min(A.miny, B.miny);
+    A.maxx = std::max(A.maxx, B.maxx); A.maxy = std::max(A.maxy, B.maxy);
+    blobs_[a].seen = std::max(blobs_[a].seen, blobs_[b].seen);
+    blobs_[b].parent = a;
+    blobs_[b].open = false;
+    merged_.push_back(b); // recycled once no run refers to it any more
+}
+
+void RunLabeler::close_blob(int root) {
+    blobs_[root].open = false;
+    done_.push_back(blobs_[root].b);
+    free_.push_back(root);
+}
+
+void RunLabeler::push_row(const unsigned char* mask, int width, int y) {
+    cur_.clear();
+    for (int x = 0; x < width; ) {
+        if (!mask[x]) { ++x; continue; }
+        int x0 = x;
+        while (x < width && mask[x]) ++x;
+        cur_.push_back({ x0, x - 1, -1 });
+    }
+
+    // Connect with the previous row (8-connectivity: diagonal touch counts).
+    size_t j = 0;
+    for (Run& r : cur_) {
+        while (j < prev_.size() && prev_[j].x1 < r.x0 - 1) ++j;
+        for (size_t k = j; k < prev_.size() && prev_[k].x0 <= r.x1 + 1; ++k) {
+            if (r.label < 0) r.label = find(prev_[k].label);
+            else unite(r.label, prev_[k].label);
+        }
+        if (r.label < 0) r.label = alloc(y);
+        const int root = find(r.label);
+        Blob& b = blobs_[root].b;
+        const int64_t len = r.x1 - r.x0 + 1;
+        b.count += len;
+        b.sx += (double)len * (r.x0 + r.x1) * 0.5;
+        b.sy += (double)len * y;
+        b.minx = std::min(b.minx, r.x0); b.maxx = std::max(b.maxx, r.x1);
+        b.miny = std::min(b.miny, y);    b.maxy = std::max(b.maxy, y);
+        blobs_[root].seen = y;
+    }
+
+    for (Run& r : cur_) r.label = find(r.label);
+    // Blobs of the previous row that nothing in this row touched are complete.
+    for (const Run& p : prev_) {
+        int root = find(p.label);
+        if (blobs_[root].open && blobs_[root].seen != y) close_blob(root);
+    }
+    free_.insert(free_.end(), merged_.begin(), merged_.end());
+    merged_.clear();
+    prev_.swap(cur_);
+}
+
+void RunLabeler::finish() {
+    for (const Run& p : prev_) {
+        int root = find(p.label);
+        if (blobs_[root].open) close_blob(root);
+    }
+    prev_.clear();
+    free_.insert(free_.end(), merged_.begin(), merged_.end());
+    merged_.clear();
+}
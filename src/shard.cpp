@@ -0,0 +1,114 @@
+#include "shard.hpp"
+#include "hash.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static const char* kResultsHeader = "# marker-results v2";
+
+bool parse_shard(const std::string& s, ShardSpec& out) {
+    size_t slash = s.find('/');
+    if (slash == std::string::npos) return false;
+    try {
+        out.index = std::stoi(s.substr(0, slash));
+        out.count = std::stoi(s.substr(slash + 1));
+    } catch (...) { return false; }
+    return out.count > 0 && out.index >= 0 && out.index < out.count;
+}
+
+bool shard_selects(const ShardSpec& spec, const std::string& path) {
+    if (spec.count <= 1) return true;
+    return hash64(path.data(), path.size()) % (uint64_t)spec.count == (uint64_t)spec.index;
+}
+
+ResultRow make_result_row(const std::string& path, const ImageResult& res, double ms, size_t peak_bytes) {
+    ResultRow r;
+    r.path = path;
+    r.ok = res.ok;
+    r.pct = res.ok ? (int)std::lround(res.markers.front().cov.ratio * 100.0) : 0;
+    r.reason = fr_to_cstr(res.fr);
+    r.ms = ms;
+    r.peak_kb = (peak_bytes + 1023) / 1024;
+    return r;
+}
+
+void write_results_header(std::ostream& os) {
+    os << kResultsHeader << "\n";
+}
+
+void write_result_row(std::ostream& os, const ResultRow& row) {
+    os << row.path << '\t' << (row.ok ? 1 : 0) << '\t' << row.pct << '\t'
+       << row.reason << '\t' << row.ms << '\t' << row.peak_kb << '\n';
+}
+
+bool read_result_rows(const std::string& file, std::vector<ResultRow>& out) {
+    std::ifstream in(file);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ls(line);
+        ResultRow r;
+        std::string ok, pct, ms, peak;
+        if (!std::getline(ls, r.path, '\t') || !std::getline(ls, ok, '\t') ||
+            !std::getline(ls, pct, '\t') || !std::getline(ls, r.reason, '\t') ||
+            !std::getline(ls, ms, '\t')) {
+            std::cerr << file << ": malformed line skipped\n";
+            continue;
+        }
+        r.ok = ok == "1";
+        r.pct = std::atoi(pct.c_str());
+        r.ms = std::atof(ms.c_str());
+        if (std::getline(ls, peak)) r.peak_kb = (size_t)std::strtoull(peak.c_str(), nullptr, 10);
+        out.push_back(std::move(r));
+    }
+    return true;
+}
+
+template<class T>
+static T percentile(const std::vector<T>& sorted, double q) {
+    if (sorted.empty()) return T();
+    size_t i = (size_t)std::ceil(q * (double)sorted.size());
+    return sorted[std::min(sorted.size() - 1, i > 0 ? i - 1 : 0)];
+}
+
+int merge_results(const std::vector<std::string>& files, std::ostream& os) {
+    std::vector<ResultRow> rows;
+    for (const auto& f : files)
+        if (!read_result_rows(f, rows)) std::cerr << f << " is not a readable results file\n";
+    if (rows.empty()) return 1;
+
+    std::stable_sort(rows.begin(), rows.end(), [](const ResultRow& a, const ResultRow& b){ return a.path < b.path; });
+    auto dup = std::adjacent_find(rows.begin(), rows.end(), [](const ResultRow& a, const ResultRow& b){ return a.path == b.path; });
+    if (dup != rows.end()) std::cerr << "[merge] warning: " << dup->path << " appears in more than one shard\n";
+
+    int pass_count = 0, fail_count = 0;
+    std::vector<double> ms; ms.reserve(rows.size());
+    std::vector<size_t> peak; peak.reserve(rows.size());
+    for (const auto& r : rows) {
+        os << r.path << " " << r.pct << "%";
+        if (!r.ok) os << " " << r.reason;
+        os << "\n";
+        if (r.ok) ++pass_count; else ++fail_count;
+        ms.push_back(r.ms);
+        peak.push_back(r.peak_kb);
+    }
+    std::sort(ms.begin(), ms.end());
+    std::sort(peak.begin(), peak.end());
+
+    os << "\nLatency ms: p50=" << percentile(ms, 0.50)
+       << " p90=" << percentile(ms, 0.90)
+       << " p99=" << percentile(ms, 0.99)
+       << " max=" << ms.back() << "\n";
+    if (peak.back() > 0)
+        os << "Peak memory KB: p50=" << percentile(peak, 0.50)
+           << " p99=" << percentile(peak, 0.99)
+           << " max=" << peak.back() << "\n";
+    os << "\nSummary: passed=" << pass_count
+       << " failed=" << fail_count
+       << " out of " << (pass_count + fail_count) << std::endl;
+    return fail_count ? 1 : 0;
+}
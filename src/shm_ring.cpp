@@ -0,0 +1,135 @@
+#include "shm_ring.hpp"
+#include <cstring>
+#include <new>
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring counters must be address-free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "ring counters must be address-free");
+
+static const uint32_t kRingMagic = 0x474E5252;   // "RRNG"
+static const uint32_t kRingVersion = 2;
+static const size_t kHeaderBytes = 4096;         // slots start page aligned
+
+struct ShmRing::Header {
+    std::atomic<uint32_t> magic;                  // stored last by create()
+    uint32_t version;
+    Layout layout;
+    uint64_t slot_stride;
+    std::atomic<uint32_t> closed;
+    alignas(64) std::atomic<uint64_t> head;       // producer: slots committed
+    alignas(64) std::atomic<uint64_t> tail;       // consumer: slots released
+    alignas(64) std::atomic<uint64_t> dropped;    // producer: frames not queued (ring full)
+};
+static_assert(sizeof(ShmRing::Layout) == 32, "Layout is shared across processes");
+
+static size_t align64(size_t n) { return (n + 63) & ~size_t(63); }
+
+ShmRing::Layout ShmRing::layout() const { return hdr_ ? hdr_->layout : Layout(); }
+
+#ifdef _WIN32
+
+bool ShmRing::create(const std::string&, const Layout&) { return false; }
+bool ShmRing::attach(const std::string&) { return false; }
+void ShmRing::close() {}
+void ShmRing::unlink() {}
+
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// shm_open wants "/name"
+static std::string shm_path(const std::string& name) { return name.empty() || name[0] == '/' ? name : "/" + name; }
+
+bool ShmRing::create(const std::string& name, const Layout& layout) {
+    static_assert(sizeof(Header) <= kHeaderBytes, "header must fit its page");
+    close();
+    if (layout.slots == 0 || layout.payload_bytes == 0) return false;
+    const std::string path = shm_path(name);
+    shm_unlink(path.c_str());   // a ring left behind by a crashed owner
+    int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) return false;
+    const uint64_t stride = align64(sizeof(SlotMeta)) + align64(layout.payload_bytes);
+    const size_t size = kHeaderBytes + (size_t)(stride * layout.slots);
+    void* p = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0)
+        p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) { shm_unlink(path.c_str()); return false; }
+
+    hdr_ = new (p) Header();   // fresh pages are zero; construct the atomics in place
+    hdr_->version = kRingVersion;
+    hdr_->layout = layout;
+    hdr_->slot_stride = stride;
+    hdr_->magic.store(kRingMagic, std::memory_order_release);
+    slots_ = static_cast<unsigned char*>(p) + kHeaderBytes;
+    map_size_ = size;
+    name_ = path;
+    return true;
+}
+
+bool ShmRing::attach(const std::string& name) {
+    close();
+    const std::string path = shm_path(name);
+    int fd = shm_open(path.c_str(), O_RDWR, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    void* p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= kHeaderBytes)
+        p = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+
+    Header* h = static_cast<Header*>(p);
+    const bool ok = h->magic.load(std::memory_order_acquire) == kRingMagic && h->version == kRingVersion &&
+                    kHeaderBytes + h->slot_stride * h->layout.slots <= (uint64_t)st.st_size;
+    if (!ok) { munmap(p, (size_t)st.st_size); return false; }
+    hdr_ = h;
+    slots_ = static_cast<unsigned char*>(p) + kHeaderBytes;
+    map_size_ = (size_t)st.st_size;
+    name_ = path;
+    return true;
+}
+
+void ShmRing::close() {
+    if (hdr_) munmap(hdr_, map_size_);
+    hdr_ = nullptr; slots_ = nullptr; map_size_ = 0;
+}
+
+void ShmRing::unlink() {
+    if (!name_.empty()) shm_unlink(name_.c_str());
+}
+#endif
+
+unsigned char* ShmRing::try_write(SlotMeta*& meta) {
+    const uint64_t head = hdr_->head.load(std::memory_order_relaxed);
+    if (head - hdr_->tail.load(std::memory_order_acquire) >= hdr_->layout.slots) return nullptr;
+    unsigned char* slot = slots_ + (head % hdr_->layout.slots) * hdr_->slot_stride;
+    meta = reinterpret_cast<SlotMeta*>(slot);
+    return slot + align64(sizeof(SlotMeta));
+}
+
+void ShmRing::commit_write() {
+    hdr_->head.fetch_add(1, std::memory_order_release);
+}
+
+void ShmRing::count_drop() {
+    hdr_->dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+unsigned char* ShmRing::try_read(SlotMeta& meta) {
+    const uint64_t tail = hdr_->tail.load(std::memory_order_relaxed);
+    if (tail == hdr_->head.load(std::memory_order_acquire)) return nullptr;
+    unsigned char* slot = slots_ + (tail % hdr_->layout.slots) * hdr_->slot_stride;
+    std::memcpy(&meta, slot, sizeof(meta));
+    return slot + align64(sizeof(SlotMeta));
+}
+
+void ShmRing::end_read() {
+    hdr_->tail.fetch_add(1, std::memory_order_release);
+}
+
+void ShmRing::mark_closed() { hdr_->closed.store(1, std::memory_order_release); }
+bool ShmRing::closed() const { return hdr_->closed.load(std::memory_order_acquire) != 0; }
+uint64_t ShmRing::dropped() const { return hdr_->dropped.load(std::memory_order_relaxed); }
+uint64_t ShmRing::written() const { return hdr_->head.load(std::memory_order_acquire); }
@@ -0,0 +1,174 @@
+#include "stage_profiler.hpp"
+#include "mem_stats.hpp"
+#include "metrics.hpp"
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const int kStages = (int)Stage::Count;
+const int kCounters = 4; // cycles, instructions, cache misses, branch misses
+
+struct StageTotals {
+    uint64_t calls = 0;
+    uint64_t ns = 0;
+    uint64_t ctr[kCounters] = {0, 0, 0, 0};
+};
+
+std::atomic<bool> g_enabled{false};
+std::atomic<bool> g_counters{false};
+std::atomic<uint64_t> g_pixels{0};
+std::mutex g_mutex;
+StageTotals g_totals[kStages]; // guarded by g_mutex
+
+// Per-thread counter file descriptors (perf counts the calling thread only).
+struct ThreadCounters {
+    int fd[kCounters] = {-1, -1, -1, -1};
+    bool opened = false;
+
+    ~ThreadCounters() {
+#ifdef __linux__
+        for (int f : fd) if (f >= 0) close(f);
+#endif
+    }
+
+    void open_all() {
+        opened = true;
+#ifdef __linux__
+        static const uint64_t configs[kCounters] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+        };
+        for (int i = 0; i < kCounters; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+#endif
+    }
+
+    void read_all(unsigned long long out[kCounters]) {
+        if (!opened) open_all();
+        for (int i = 0; i < kCounters; ++i) {
+            out[i] = 0;
+#ifdef __linux__
+            if (fd[i] >= 0 && ::read(fd[i], &out[i], sizeof(out[i])) != (ssize_t)sizeof(out[i])) out[i] = 0;
+#endif
+        }
+    }
+};
+
+thread_local ThreadCounters t_counters;
+
+long long now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+const char* stage_name(Stage s) {
+    switch (s) {
+    case Stage::HsvLabel:   return "hsv_label";
+    case Stage::Morphology: return "morphology";
+    case Stage::Contours:   return "contours";
+    case Stage::PcaKmeans:  return "pca_kmeans";
+    case Stage::Assignment: return "assignment";
+    case Stage::Hull:       return "hull";
+    default:                return "?";
+    }
+}
+
+bool stage_profiler_enable() {
+    g_enabled = true;
+    // perf counts the calling thread only, and stage wall times would overlap
+    // across OpenCV's workers: keep every stage's work on the calling thread.
+    cv::setNumThreads(1);
+    // Probe on this thread: all four counters must open, otherwise timing only.
+    unsigned long long probe[kCounters];
+    t_counters.read_all(probe);
+    bool ok = true;
+    for (int f : t_counters.fd) ok = ok && f >= 0;
+    g_counters = ok;
+    return ok;
+}
+
+bool stage_profiler_enabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+void stage_profiler_add_pixels(size_t pixels) {
+    if (stage_profiler_enabled()) g_pixels.fetch_add(pixels, std::memory_order_relaxed);
+    metrics_add_pixels(pixels);
+}
+
+StageTimer::StageTimer(Stage s)
+    : stage_(s), on_(stage_profiler_enabled()), metrics_(metrics_enabled()), mem_saved_(mem_stage_begin()) {
+    if (!on_ && !metrics_) return;
+    if (on_ && g_counters.load(std::memory_order_relaxed)) t_counters.read_all(c0_);
+    t0_ns_ = now_ns();
+}
+
+StageTimer::~StageTimer() {
+    mem_stage_end(stage_, mem_saved_);
+    if (!on_ && !metrics_) return;
+    const long long t1 = now_ns();
+    if (metrics_) metrics_record_stage(stage_, t1 - t0_ns_);
+    if (!on_) return;
+    unsigned long long c1[kCounters] = {0, 0, 0, 0};
+    if (g_counters.load(std::memory_order_relaxed)) t_counters.read_all(c1);
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    StageTotals& t = g_totals[(int)stage_];
+    ++t.calls;
+    t.ns += (uint64_t)(t1 - t0_ns_);
+    for (int i = 0; i < kCounters; ++i) t.ctr[i] += c1[i] - c0_[i];
+}
+
+void stage_profiler_report(std::ostream& os) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    const double mp = (double)g_pixels.load() / 1e6;
+    const bool hw = g_counters.load();
+    const std::ios_base::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    os << "\n[perf] per-stage totals, averaged per megapixel (" << mp << " MP processed, OpenCV single-threaded"
+       << (hw ? "" : "; hardware counters unavailable, timing only") << ")\n";
+    os << std::left << std::setw(12) << "stage" << std::right << std::setw(8) << "calls"
+       << std::setw(12) << "ms/MP";
+    if (hw) os << std::setw(14) << "cycles/MP" << std::setw(14) << "instr/MP" << std::setw(7) << "IPC"
+               << std::setw(14) << "cmiss/MP" << std::setw(14) << "bmiss/MP";
+    os << "\n";
+    const double div = mp > 0 ? mp : 1.0;
+    for (int s = 0; s < kStages; ++s) {
+        const StageTotals& t = g_totals[s];
+        os << std::left << std::setw(12) << stage_name((Stage)s) << std::right << std::setw(8) << t.calls
+           << std::setw(12) << std::fixed << std::setprecision(3) << (double)t.ns / 1e6 / div;
+        if (hw) {
+            os << std::setprecision(0)
+               << std::setw(14) << (double)t.ctr[0] / div
+               << std::setw(14) << (double)t.ctr[1] / div
+               << std::setw(7) << std::setprecision(2) << (t.ctr[0] ? (double)t.ctr[1] / (double)t.ctr[0] : 0.0)
+               << std::setprecision(0)
+               << std::setw(14) << (double)t.ctr[2] / div
+               << std::setw(14) << (double)t.ctr[3] / div;
+        }
+        os << "\n";
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
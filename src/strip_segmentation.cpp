@@ -0,0 +1,97 @@
+#include "strip_segmentation.hpp"
+#include "palette.hpp"
+#include "mask_ops.hpp"
+#include "run_labeler.hpp"
+#include "stage_profiler.hpp"
+#include <algorithm>
+#include <cstring>
+using namespace cv;
+using std::vector;
+
+std::vector<Patch> segment_color_patches_strips(StripSource& src,
+                                                const SegmentationParams& params,
+                                                int strip_rows,
+                                                const Deadline* dl) {
+    using P = DefaultPalette;
+    const int W = src.width(), H = src.height();
+    const int halo = kMaskHaloRows;
+    CV_Assert(W > 0 && H > 0 && strip_rows > 0);
+    strip_rows = std::min(strip_rows, H);
+
+    // Window over image rows [top, top + have): the current strip plus its
+    // halos. Rows still needed by the next strip are shifted up, not re-read.
+    Mat win(strip_rows + 2 * halo, W, CV_8UC3);
+    Mat hsv(win.size(), CV_8UC3);
+    Mat masks[P::kColors];
+    for (Mat& m : masks) m.create(win.size(), CV_8UC1);
+    RunLabeler labelers[P::kColors];
+
+    const double img_area = (double)W * (double)H;
+    const double min_area = params.min_area_ratio * img_area;
+    const double max_area = params.max_area_ratio * img_area;
+
+    vector<Patch> patches;
+    int next_id = 0;
+    auto collect = [&](int ci) {
+        for (const RunLabeler::Blob& b : labelers[ci].take()) {
+            const double a = (double)b.count;
+            if (a < min_area || a > max_area) continue;
+            Rect box(b.minx, b.miny, b.maxx - b.minx + 1, b.maxy - b.miny + 1);
+            Point2f center((float)(b.sx / a), (float)(b.sy / a));
+            patches.push_back(Patch{P::names[ci], box, center, a, next_id++});
+        }
+    };
+
+    int top = 0, have = 0;
+    for (int y0 = 0; y0 < H; y0 += strip_rows) {
+        if (dl && dl->expired()) return patches;
+        const int y1 = std::min(H, y0 + strip_rows);
+        const int want_top = std::max(0, y0 - halo);
+        const int want_end = std::min(H, y1 + halo);
+
+        // Slide the window: drop rows above want_top, decode up to want_end.
+        const int keep = top + have - want_top;
+        if (keep > 0 && want_top > top)
+            std::memmove(win.ptr(0), win.ptr(want_top - top), (size_t)keep * win.step);
+        top = want_top;
+        have = std::max(keep, 0);
+        while (top + have < want_end) {
+            const int got = src.read_rows(win.ptr(have), win.step, want_end - top - have);
+            if (got <= 0) break;          // truncated input: label what decoded
+            have += got;
+        }
+        if (have <= 0 || top + have <= y0) break;
+        const int end = top + have;
+
+        // Headers of exactly `have` rows, not rowRange ROIs: blur and morphology
+        // extrapolate past an ROI into its parent's stale rows below `have`,
+        // where the whole-image pass sees the image border.
+        Mat bgr(have, W, CV_8UC3, win.ptr(), win.step), h(have, W, CV_8UC3, hsv.ptr(), hsv.step);
+        Mat m[P::kColors];
+        for (int c = 0; c < P::kColors; ++c) m[c] = Mat(have, W, CV_8UC1, masks[c].ptr(), masks[c].step);
+        {
+            StageTimer st(Stage::HsvLabel);
+            cvtColor(bgr, h, COLOR_BGR2HSV);
+            GaussianBlur(h, h, Size(3,3), 0);
+            classify_masks<P>(h, m);
+        }
+        {
+            StageTimer st(Stage::Morphology);
+            for (Mat& mm : m) clean_mask(mm);
+        }
+        {
+            // Only the strip's own rows are final; halo rows belong to neighbours.
+            StageTimer st(Stage::Contours);
+            const int last = std::min(y1, end);
+            for (int c = 0; c < P::kColors; ++c) {
+                for (int y = y0; y < last; ++y) labelers[c].push_row(m[c].ptr(y - top), W, y);
+                collect(c);
+            }
+        }
+        stage_profiler_add_pixels((size_t)(std::min(y1, end) - y0) * (size_t)W);
+        if (end < want_end) break;
+    }
+
+    for (int c = 0; c < P::kColors; ++c) { labelers[c].finish(); collect(c); }
+    return patches;
+}
@@ -0,0 +1,270 @@
+#include "strip_source.hpp"
+#include <opencv2/opencv.hpp>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef MARKER_HAVE_PNG
+#include <png.h>
+#endif
+#ifdef MARKER_HAVE_JPEG
+#include <jpeglib.h>
+#endif
+#ifdef MARKER_HAVE_TIFF
+#include <tiffio.h>
+#endif
+
+cv::Mat StripSource::read_all() {
+    cv::Mat img(height_, width_, CV_8UC3);
+    int got = 0;
+    while (got < height_) {
+        const int n = read_rows(img.ptr(got), img.step, height_ - got);
+        if (n <= 0) break;
+        got += n;
+    }
+    return got == height_ ? img : img.rowRange(0, got).clone();
+}
+
+namespace {
+
+// Fallback: whole image decoded by OpenCV, handed out in strips.
+class MatStripSource : public StripSource {
+public:
+    explicit MatStripSource(cv::Mat img) : img_(std::move(img)) { width_ = img_.cols; height_ = img_.rows; }
+    bool streaming() const override { return false; }
+    cv::Mat read_all() override { next_ = height_; return img_; }
+    int read_rows(unsigned char* dst, size_t stride, int max_rows) override {
+        int n = std::min(max_rows, height_ - next_);
+        for (int i = 0; i < n; ++i) std::memcpy(dst + (size_t)i * stride, img_.ptr(next_ + i), (size_t)width_ * 3);
+        next_ += n;
+        return n;
+    }
+private:
+    cv::Mat img_;
+    int next_ = 0;
+};
+
+#ifdef MARKER_HAVE_PNG
+class PngStripSource : public StripSource {
+public:
+    ~PngStripSource() override {
+        if (png_) png_destroy_read_struct(&png_, &info_, nullptr);
+        if (fp_) std::fclose(fp_);
+    }
+
+    bool open(const std::string& path) {
+        fp_ = std::fopen(path.c_str(), "rb");
+        if (!fp_) return false;
+        png_ = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+        if (!png_) return false;
+        info_ = png_create_info_struct(png_);
+        if (!info_) return false;
+        if (setjmp(png_jmpbuf(png_))) return false;
+
+        png_init_io(png_, fp_);
+        png_read_info(png_, info_);
+        if (png_get_interlace_type(png_, info_) != PNG_INTERLACE_NONE) return false; // needs whole image
+
+        const int color = png_get_color_type(png_, info_);
+        png_set_expand(png_);     // palette -> RGB, low-bit gray -> 8 bit, tRNS -> alpha
+        png_set_strip_16(png_);
+        png_set_strip_alpha(png_);
+        if (color == PNG_COLOR_TYPE_GRAY || color == PNG_COLOR_TYPE_GRAY_ALPHA) png_set_gray_to_rgb(png_);
+        png_set_bgr(png_);
+        png_read_update_info(png_, info_);
+
+        width_ = (int)png_get_image_width(png_, info_);
+        height_ = (int)png_get_image_height(png_, info_);
+        return png_get_rowbytes(png_, info_) == (size_t)width_ * 3;
+    }
+
+    int read_rows(unsigned char* dst, size_t stride, int max_rows) override {
+        int n = std::min(max_rows, height_ - next_);
+        volatile int done = 0;   // read after a longjmp
+        if (setjmp(png_jmpbuf(png_))) { next_ = height_; return done; }
+        for (; done < n; ++done) png_read_row(png_, dst + (size_t)done * stride, nullptr);
+        next_ += done;
+        return done;
+    }
+
+private:
+    FILE* fp_ = nullptr;
+    png_structp png_ = nullptr;
+    png_infop info_ = nullptr;
+    int next_ = 0;
+};
+#endif
+
+#ifdef MARKER_HAVE_JPEG
+struct JpegError {
+    jpeg_error_mgr mgr;
+    std::jmp_buf jmp;
+};
+void jpeg_error_exit_longjmp(j_common_ptr cinfo) {
+    std::longjmp(reinterpret_cast<JpegError*>(cinfo->err)->jmp, 1);
+}
+
+// EXIF Orientation (tag 0x0112 in IFD0) of an APP1 marker; 1 when absent.
+int exif_orientation(const jpeg_saved_marker_ptr markers) {
+    for (jpeg_saved_marker_ptr m = markers; m; m = m->next) {
+        const unsigned char* p = m->data;
+        const size_t len = m->data_length;
+        if (m->marker != JPEG_APP0 + 1 || len < 14 || std::memcmp(p, "Exif\0\0", 6) != 0) continue;
+        const unsigned char* t = p + 6;   // TIFF header
+        const size_t tlen = len - 6;
+        const bool le = t[0] == 'I' && t[1] == 'I';
+        if (!le && !(t[0] == 'M' && t[1] == 'M')) continue;
+        auto u16 = [&](size_t o) { return le ? (unsigned)(t[o] | t[o+1] << 8) : (unsigned)(t[o] << 8 | t[o+1]); };
+        auto u32 = [&](size_t o) { return le ? (size_t)u16(o) | (size_t)u16(o + 2) << 16 : (size_t)u16(o) << 16 | u16(o + 2); };
+        const size_t ifd = u32(4);
+        if (ifd + 2 > tlen) continue;
+        const unsigned count = u16(ifd);
+        for (unsigned i = 0; i < count && ifd + 2 + (size_t)(i + 1) * 12 <= tlen; ++i) {
+            const size_t e = ifd + 2 + (size_t)i * 12;
+            if (u16(e) == 0x0112) return (int)u16(e + 8);
+        }
+    }
+    return 1;
+}
+
+class JpegStripSource : public StripSource {
+public:
+    ~JpegStripSource() override {
+        if (created_) jpeg_destroy_decompress(&cinfo_);
+        if (fp_) std::fclose(fp_);
+    }
+
+    bool open(const std::string& path) {
+        fp_ = std::fopen(path.c_str(), "rb");
+        if (!fp_) return false;
+        cinfo_.err = jpeg_std_error(&err_.mgr);
+        err_.mgr.error_exit = jpeg_error_exit_longjmp;
+        if (setjmp(err_.jmp)) return false;
+        jpeg_create_decompress(&cinfo_);
+        created_ = true;
+        jpeg_stdio_src(&cinfo_, fp_);
+        jpeg_save_markers(&cinfo_, JPEG_APP0 + 1, 0xFFFF);
+        jpeg_read_header(&cinfo_, TRUE);
+        // cv::imread rotates by the EXIF orientation; a rotated image goes
+        // through the whole-image decode so strips see the same pixels
+        if (exif_orientation(cinfo_.marker_list) != 1) return false;
+        if (cinfo_.jpeg_color_space == JCS_CMYK || cinfo_.jpeg_color_space == JCS_YCCK) return false;
+        gray_ = cinfo_.num_components == 1;
+        cinfo_.out_color_space = gray_ ? JCS_GRAYSCALE : JCS_RGB;
+        jpeg_start_decompress(&cinfo_);
+        width_ = (int)cinfo_.output_width;
+        height_ = (int)cinfo_.output_height;
+        return true;
+    }
+
+    int read_rows(unsigned char* dst, size_t stride, int max_rows) override {
+        volatile int done = 0;   // read after a longjmp
+        if (setjmp(err_.jmp)) return done;
+        while (done < max_rows && cinfo_.output_scanline < cinfo_.output_height) {
+            unsigned char* row = dst + (size_t)done * stride;
+            JSAMPROW rp = row;
+            if (jpeg_read_scanlines(&cinfo_, &rp, 1) != 1) break;
+            if (gray_) {
+                for (int x = width_ - 1; x >= 0; --x) row[3*x] = row[3*x+1] = row[3*x+2] = row[x];
+            } else {
+                for (int x = 0; x < width_; ++x) std::swap(row[3*x], row[3*x+2]); // RGB -> BGR
+            }
+            ++done;
+        }
+        return done;
+    }
+
+private:
+    FILE* fp_ = nullptr;
+    jpeg_decompress_struct cinfo_{};
+    JpegError err_{};
+    bool created_ = false;
+    bool gray_ = false;
+};
+#endif
+
+#ifdef MARKER_HAVE_TIFF
+class TiffStripSource : public StripSource {
+public:
+    ~TiffStripSource() override { if (tif_) TIFFClose(tif_); }
+
+    bool open(const std::string& path) {
+        tif_ = TIFFOpen(path.c_str(), "r");
+        if (!tif_ || TIFFIsTiled(tif_)) return false;
+        uint32_t w = 0, h = 0;
+        uint16_t bps = 0, planar = PLANARCONFIG_CONTIG, photo = 0;
+        TIFFGetField(tif_, TIFFTAG_IMAGEWIDTH, &w);
+        TIFFGetField(tif_, TIFFTAG_IMAGELENGTH, &h);
+        TIFFGetFieldDefaulted(tif_, TIFFTAG_BITSPERSAMPLE, &bps);
+        TIFFGetFieldDefaulted(tif_, TIFFTAG_SAMPLESPERPIXEL, &spp_);
+        TIFFGetFieldDefaulted(tif_, TIFFTAG_PLANARCONFIG, &planar);
+        TIFFGetField(tif_, TIFFTAG_PHOTOMETRIC, &photo);
+        if (bps != 8 || planar != PLANARCONFIG_CONTIG) return false;
+        if (!((photo == PHOTOMETRIC_RGB && spp_ >= 3) || (photo == PHOTOMETRIC_MINISBLACK && spp_ >= 1))) return false;
+        width_ = (int)w; height_ = (int)h;
+        line_.resize((size_t)TIFFScanlineSize(tif_));
+        return true;
+    }
+
+    int read_rows(unsigned char* dst, size_t stride, int max_rows) override {
+        int done = 0;
+        for (; done < max_rows && next_ < height_; ++done, ++next_) {
+            if (TIFFReadScanline(tif_, line_.data(), (uint32_t)next_, 0) < 0) break;
+            unsigned char* row = dst + (size_t)done * stride;
+            for (int x = 0; x < width_; ++x) {
+                const unsigned char* p = &line_[(size_t)x * spp_];
+                if (spp_ >= 3) { row[3*x] = p[2]; row[3*x+1] = p[1]; row[3*x+2] = p[0]; }
+                else           { row[3*x] = row[3*x+1] = row[3*x+2] = p[0]; }
+            }
+        }
+        return done;
+    }
+
+private:
+    TIFF* tif_ = nullptr;
+    uint16_t spp_ = 1;
+    std::vector<unsigned char> line_;
+    int next_ = 0;
+};
+#endif
+
+template<class T>
+std::unique_ptr<StripSource> try_open(const std::string& path) {
+    auto s = std::make_unique<T>();
+    if (s->open(path)) return s;
+    return nullptr;
+}
+
+} // namespace
+
+std::unique_ptr<StripSource> open_strip_source(const std::string& path) {
+    unsigned char sig[8] = {0};
+    if (FILE* f = std::fopen(path.c_str(), "rb")) {
+        size_t n = std::fread(sig, 1, sizeof(sig), f);
+        std::fclose(f);
+        (void)n;
+    }
+    else return nullptr;
+
+    std::unique_ptr<StripSource> s;
+#ifdef MARKER_HAVE_PNG
+    if (!s && std::memcmp(sig, "\x89PNG\r\n\x1a\n", 8) == 0) s = try_open<PngStripSource>(path);
+#endif
+#ifdef MARKER_HAVE_JPEG
+    if (!s && sig[0] == 0xFF && sig[1] == 0xD8) s = try_open<JpegStripSource>(path);
+#endif
+#ifdef MARKER_HAVE_TIFF
+    if (!s && (std::memcmp(sig, "II*\0", 4) == 0 || std::memcmp(sig, "MM\0*", 4) == 0)) s = try_open<TiffStripSource>(path);
+#endif
+    if (s) return s;
+
+    cv::Mat img = cv::imread(path, cv::IMREAD_COLOR);
+    if (img.empty()) return nullptr;
+    return std::make_unique<MatStripSource>(std::move(img));
+}
+
+std::unique_ptr<StripSource> strip_source_from_mat(const cv::Mat& bgr) {
+    CV_Assert(bgr.type() == CV_8UC3);
+    return std::make_unique<MatStripSource>(bgr);
+}
@@ -0,0 +1,57 @@
+#include "yuv_frame.hpp"
+using namespace cv;
+
+bool yuv_planes(const cv::Mat& yuv, YuvFormat format, YuvPlanes& out) {
+    if (yuv.type() != CV_8UC1 || yuv.rows % 3 != 0 || yuv.cols % 2 != 0) return false;
+    const int h = yuv.rows / 3 * 2, w = yuv.cols;
+    if (h % 2 != 0 || h == 0) return false;
+    const size_t cstep = yuv.step / 2;   // chroma rows: half the luma step
+    uchar* chroma = const_cast<uchar*>(yuv.ptr<uchar>(h));
+    out = YuvPlanes();
+    out.format = format;
+    out.y = yuv.rowRange(0, h);
+    switch (format) {
+    case YuvFormat::NV12:
+        out.uv = Mat(h / 2, w / 2, CV_8UC2, chroma, yuv.step);
+        return true;
+    case YuvFormat::I420:
+        out.u = Mat(h / 2, w / 2, CV_8UC1, chroma, cstep);
+        out.v = Mat(h / 2, w / 2, CV_8UC1, chroma + (h / 2) * cstep, cstep);
+        return true;
+    default:
+        return false;
+    }
+}
+
+void bgr_to_yuv(const cv::Mat& bgr, YuvFormat format, cv::Mat& yuv) {
+    Mat i420;
+    cvtColor(bgr, i420, COLOR_BGR2YUV_I420);
+    if (format == YuvFormat::I420) { yuv = i420; return; }
+    // NV12: same luma, the two chroma planes interleaved
+    const int h = bgr.rows, w = bgr.cols;
+    yuv.create(h * 3 / 2, w, CV_8UC1);
+    i420.rowRange(0, h).copyTo(yuv.rowRange(0, h));
+    YuvPlanes src, dst;
+    yuv_planes(i420, YuvFormat::I420, src);
+    yuv_planes(yuv, YuvFormat::NV12, dst);
+    const Mat uv[2] = { src.u, src.v };
+    merge(uv, 2, dst.uv);
+}
+
+void yuv_to_bgr(const cv::Mat& yuv, YuvFormat format, cv::Mat& bgr) {
+    cvtColor(yuv, bgr, format == YuvFormat::NV12 ? COLOR_YUV2BGR_NV12 : COLOR_YUV2BGR_I420);
+}
+
+bool parse_yuv_format(const std::string& s, YuvFormat& out) {
+    if (s == "nv12" || s == "NV12") { out = YuvFormat::NV12; return true; }
+    if (s == "i420" || s == "I420") { out = YuvFormat::I420; return true; }
+    return false;
+}
+
+const char* yuv_format_name(YuvFormat f) {
+    switch (f) {
+    case YuvFormat::NV12: return "nv12";
+    case YuvFormat::I420: return "i420";
+    default:              return "none";
+    }
+}
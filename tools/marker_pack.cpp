@@ -0,0 +1,56 @@
+// marker_pack.cpp - build a packed image archive for SodyoAssignment --pack.
+//
+//   marker_pack <out.mkpack> [--list files.txt] inputs...
+//
+// Inputs are image files or directories (their regular, non-hidden files,
+// not recursive, in name order); --list adds one path per line. Entries are
+// named by the path as given and stored in argument order, which is the order
+// --pack processes and prefetches them: put files that are read together next
+// to each other. The bytes are copied as they are (no re-encoding).
+#include "image_pack.hpp"
+#include "mapped_file.hpp"
+#include "tool_inputs.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: marker_pack <out.mkpack> [--list files.txt] inputs...\n";
+        return 1;
+    }
+    const std::string out_path = argv[1];
+    std::vector<std::string> inputs;
+    for (int i = 2; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--list" && i + 1 < argc) {
+            std::ifstream list(argv[++i]);
+            if (!list) { std::cerr << "cannot read " << argv[i] << "\n"; return 1; }
+            for (std::string line; std::getline(list, line);)
+                if (!line.empty() && line[0] != '#') inputs.push_back(line);
+            continue;
+        }
+        add_input(a, inputs);
+    }
+
+    ImagePackWriter pack;
+    if (!pack.open(out_path)) { std::cerr << "cannot write " << out_path << "\n"; return 1; }
+    size_t skipped = 0;
+    unsigned long long total = 0;
+    for (const auto& path : inputs) {
+        MappedFile mf;
+        if (!mf.open(path) || mf.size() == 0) {
+            std::cerr << path << " is not a readable file, skipped\n";
+            ++skipped;
+            continue;
+        }
+        if (!pack.add(path, mf.data(), mf.size())) { std::cerr << "write error on " << out_path << "\n"; return 1; }
+        total += mf.size();
+    }
+    if (!pack.finish()) { std::cerr << "cannot finish " << out_path << "\n"; return 1; }
+    std::cout << out_path << ": " << pack.count() << " images, " << total / 1024 << " KB"
+              << (skipped ? ", " + std::to_string(skipped) + " skipped" : std::string()) << "\n";
+    return skipped ? 2 : 0;
+}
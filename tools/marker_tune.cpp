@@ -0,0 +1,482 @@
+// marker_tune.cpp - offline parameter sweep against labeled images.
+//
+//   marker_tune --truth labels.tsv [--patches patches.bin] [--multi] [--threads N]
+//               [--top K] [--out trials.tsv] [--sweep name=lo:hi:step | name=v1,v2,...]...
+//
+// Every image is segmented once, without the area filter, and its patch list is
+// kept in --patches keyed by a hash of the file bytes, so later runs skip decode
+// and segmentation. Grid geometry (PCA, k-means, assignment, spacing CVs, hull
+// coverage) depends only on the area filter (and group_link with --multi), so
+// it is computed once per distinct value of those; each trial then only re-runs
+// the decision (grid_accepted) per image. The thumbnail pre-rejection depends on
+// coverage_thresh, so its per-color counts are stored too and re-checked per
+// trial (prefilter_passes_t).
+//
+// labels.tsv: "path<TAB>ok(0/1)[<TAB>percent]" per line, '#' comments. A
+// --results file of a trusted run has the same leading columns and works as is.
+#include "types.hpp"
+#include "color_segmentation.hpp"
+#include "grid_detector.hpp"
+#include "coverage.hpp"
+#include "pipeline.hpp"
+#include "prefilter.hpp"
+#include "palette.hpp"
+#include "hash.hpp"
+#include "mapped_file.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+// ---- patch store ------------------------------------------------------------
+// header | { EntryHeader, ThumbRec, path bytes, PatchRec × n_patches }...
+const char kStoreMagic[8] = {'M','K','P','A','T','C','H','1'};
+const uint32_t kStoreVersion = 2;   // bump when segmentation output changes
+
+struct StoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t palette;               // low bits of a hash of the palette bands
+    uint64_t count;
+};
+struct EntryHeader {
+    uint64_t content_hash;
+    int32_t width, height;
+    uint32_t path_len, n_patches;
+};
+struct ThumbRec {                   // PrefilterCounts<DefaultPalette>
+    int32_t pixels, colored;
+    int32_t per_color[DefaultPalette::kColors];
+};
+struct PatchRec {
+    double area;
+    int32_t x, y, w, h;
+    float cx, cy;
+    uint32_t color;                 // index into DefaultPalette::names
+    uint32_t pad;
+};
+static_assert(sizeof(StoreHeader) == 24, "store layout");
+static_assert(sizeof(EntryHeader) == 24, "store layout");
+static_assert(sizeof(ThumbRec) == 8 + 4 * DefaultPalette::kColors, "store layout");
+static_assert(sizeof(PatchRec) == 40, "store layout");
+
+struct ImageEntry {
+    std::string path;
+    uint64_t hash = 0;
+    cv::Size size;
+    std::vector<Patch> patches;     // unfiltered, palette order
+    PrefilterCounts<DefaultPalette> thumb;  // default prefilter_side
+};
+
+uint32_t palette_tag() {
+    return (uint32_t)hash64(DefaultPalette::bands, sizeof(DefaultPalette::bands), kStoreVersion);
+}
+
+int color_index(const std::string& name) {
+    for (int c = 0; c < DefaultPalette::kColors; ++c)
+        if (name == DefaultPalette::names[c]) return c;
+    return -1;
+}
+
+bool load_store(const std::string& file, std::map<std::string, ImageEntry>& out) {
+    MappedFile mf;
+    if (!mf.open(file) || mf.size() < sizeof(StoreHeader)) return false;
+    const unsigned char* p = mf.data();
+    const unsigned char* end = p + mf.size();
+    StoreHeader h;
+    std::memcpy(&h, p, sizeof(h)); p += sizeof(h);
+    if (std::memcmp(h.magic, kStoreMagic, 8) != 0 || h.version != kStoreVersion || h.palette != palette_tag())
+        return false;
+    for (uint64_t i = 0; i < h.count; ++i) {
+        EntryHeader eh;
+        if ((size_t)(end - p) < sizeof(eh)) return false;
+        std::memcpy(&eh, p, sizeof(eh)); p += sizeof(eh);
+        if ((size_t)(end - p) < sizeof(ThumbRec) + eh.path_len + (size_t)eh.n_patches * sizeof(PatchRec)) return false;
+        ImageEntry e;
+        ThumbRec tr;
+        std::memcpy(&tr, p, sizeof(tr)); p += sizeof(tr);
+        e.thumb.pixels = tr.pixels;
+        e.thumb.colored = tr.colored;
+        std::copy(std::begin(tr.per_color), std::end(tr.per_color), e.thumb.per_color);
+        e.path.assign((const char*)p, eh.path_len); p += eh.path_len;
+        e.hash = eh.content_hash;
+        e.size = cv::Size(eh.width, eh.height);
+        e.patches.reserve(eh.n_patches);
+        for (uint32_t k = 0; k < eh.n_patches; ++k, p += sizeof(PatchRec)) {
+            PatchRec r;
+            std::memcpy(&r, p, sizeof(r));
+            if (r.color >= (uint32_t)DefaultPalette::kColors) return false;
+            e.patches.push_back(Patch{DefaultPalette::names[r.color], cv::Rect(r.x, r.y, r.w, r.h),
+                                      cv::Point2f(r.cx, r.cy), r.area, (int)k});
+        }
+        out[e.path] = std::move(e);
+    }
+    return true;
+}
+
+// Written to a temporary and renamed, so an interrupted run keeps the old store.
+bool save_store(const std::string& file, const std::vector<ImageEntry>& entries) {
+    const std::string tmp = file + ".tmp";
+    {
+        std::ofstream os(tmp, std::ios::binary | std::ios::trunc);
+        if (!os) return false;
+        StoreHeader h;
+        std::memcpy(h.magic, kStoreMagic, 8);
+        h.version = kStoreVersion;
+        h.palette = palette_tag();
+        h.count = entries.size();
+        os.write((const char*)&h, sizeof(h));
+        for (const auto& e : entries) {
+            EntryHeader eh{e.hash, e.size.width, e.size.height, (uint32_t)e.path.size(), (uint32_t)e.patches.size()};
+            os.write((const char*)&eh, sizeof(eh));
+            ThumbRec tr{e.thumb.pixels, e.thumb.colored, {}};
+            std::copy(std::begin(e.thumb.per_color), std::end(e.thumb.per_color), tr.per_color);
+            os.write((const char*)&tr, sizeof(tr));
+            os.write(e.path.data(), (std::streamsize)e.path.size());
+            for (const auto& pt : e.patches) {
+                PatchRec r{pt.area, pt.box.x, pt.box.y, pt.box.width, pt.box.height,
+                           pt.center.x, pt.center.y, (uint32_t)color_index(pt.color), 0};
+                os.write((const char*)&r, sizeof(r));
+            }
+        }
+        if (!os) return false;
+    }
+    return std::rename(tmp.c_str(), file.c_str()) == 0;
+}
+
+// ---- labels and sweep axes --------------------------------------------------
+struct Truth {
+    std::string path;
+    bool ok = false;
+    int pct = -1;                   // -1: not labeled
+};
+
+bool read_truth(const std::string& file, std::vector<Truth>& out) {
+    std::ifstream in(file);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::vector<std::string> cols;
+        std::istringstream ls(line);
+        for (std::string c; std::getline(ls, c, '\t');) cols.push_back(c);
+        if (cols.size() < 2) { std::cerr << file << ": malformed line skipped\n"; continue; }
+        Truth t;
+        t.path = cols[0];
+        t.ok = cols[1] == "1";
+        if (cols.size() >= 3 && !cols[2].empty()) t.pct = std::atoi(cols[2].c_str());
+        out.push_back(std::move(t));
+    }
+    return true;
+}
+
+// Everything one trial varies. Area ratios, group_link and the pre-check
+// settings form the geometry key.
+struct TrialParams {
+    GridParams gp = default_grid_params();
+    double min_area_ratio = default_segmentation_params().min_area_ratio;
+    double max_area_ratio = default_segmentation_params().max_area_ratio;
+};
+
+const char* const kAxisNames[] = {
+    "cvx_thresh", "cvy_thresh", "coverage_thresh", "coverage_fallback", "coverage_soft",
+    "min_area_ratio", "max_area_ratio", "group_link", "min_colors", "area_compat"
+};
+
+bool set_param(TrialParams& t, const std::string& name, double v) {
+    if      (name == "cvx_thresh")        t.gp.cvx_thresh = (float)v;
+    else if (name == "cvy_thresh")        t.gp.cvy_thresh = (float)v;
+    else if (name == "coverage_thresh")   t.gp.coverage_thresh = (float)v;
+    else if (name == "coverage_fallback") t.gp.coverage_fallback = (float)v;
+    else if (name == "coverage_soft")     t.gp.coverage_soft = (float)v;
+    else if (name == "min_area_ratio")    t.min_area_ratio = v;
+    else if (name == "max_area_ratio")    t.max_area_ratio = v;
+    else if (name == "group_link")        t.gp.group_link = (float)v;
+    else if (name == "min_colors")        t.gp.min_colors = (int)v;
+    else if (name == "area_compat")       t.gp.area_compat = (float)v;
+    else return false;
+    return true;
+}
+
+double get_param(const TrialParams& t, const std::string& name) {
+    if (name == "cvx_thresh")        return t.gp.cvx_thresh;
+    if (name == "cvy_thresh")        return t.gp.cvy_thresh;
+    if (name == "coverage_thresh")   return t.gp.coverage_thresh;
+    if (name == "coverage_fallback") return t.gp.coverage_fallback;
+    if (name == "coverage_soft")     return t.gp.coverage_soft;
+    if (name == "min_area_ratio")    return t.min_area_ratio;
+    if (name == "max_area_ratio")    return t.max_area_ratio;
+    if (name == "group_link")        return t.gp.group_link;
+    if (name == "min_colors")        return t.gp.min_colors;
+    if (name == "area_compat")       return t.gp.area_compat;
+    return 0.0;
+}
+
+struct Axis {
+    std::string name;
+    std::vector<double> values;
+};
+
+// "name=lo:hi:step" (inclusive) or "name=v1,v2,..."
+bool parse_axis(const std::string& s, Axis& out) {
+    const size_t eq = s.find('=');
+    if (eq == std::string::npos) return false;
+    out.name = s.substr(0, eq);
+    if (std::find(std::begin(kAxisNames), std::end(kAxisNames), out.name) == std::end(kAxisNames)) return false;
+    const std::string spec = s.substr(eq + 1);
+    double lo, hi, step;
+    char c1, c2;
+    std::istringstream ss(spec);
+    if (spec.find(':') != std::string::npos) {
+        if (!(ss >> lo >> c1 >> hi >> c2 >> step) || c1 != ':' || c2 != ':' || step <= 0 || hi < lo) return false;
+        for (int i = 0; lo + i * step <= hi + step * 1e-6; ++i) out.values.push_back(lo + i * step);
+    }
+    else {
+        for (std::string v; std::getline(ss, v, ',');) out.values.push_back(std::atof(v.c_str()));
+    }
+    return !out.values.empty();
+}
+
+// ---- evaluation -------------------------------------------------------------
+struct GridGeom {
+    float cvx = 0.f, cvy = 0.f;
+    double ratio = 0.0;
+    bool bad = false;               // degenerate hull (BAD_BBOX)
+};
+struct ImageGeom {
+    FailureReason fr = FailureReason::NONE;
+    std::vector<GridGeom> grids;
+};
+
+ImageGeom compute_geometry(const ImageEntry& e, const TrialParams& t, bool multi) {
+    ImageGeom g;
+    const double img_area = (double)e.size.width * (double)e.size.height;
+    std::vector<Patch> patches;
+    for (const Patch& p : e.patches) {
+        if (p.area < t.min_area_ratio * img_area || p.area > t.max_area_ratio * img_area) continue;
+        patches.push_back(p);
+        patches.back().id = (int)patches.size() - 1;
+    }
+    if (patches.size() < 3) { g.fr = FailureReason::FEW_PATCHES; return g; }
+    // Same pre-checks as the pipeline, minus the spread test: it only rejects
+    // what decide() rejects anyway, and coverage_thresh varies per trial.
+    GridParams pre = t.gp;
+    pre.coverage_thresh = 0.f;
+    g.fr = precheck_candidates(patches, e.size, pre);
+    if (g.fr != FailureReason::NONE) return g;
+
+    // k-means seeding must not depend on which worker ran what before
+    cv::theRNG() = cv::RNG(e.hash | 1);
+    std::vector<GridDetection> grids(1);
+    g.fr = multi ? detect_all_grids(patches, grids, t.gp)
+                 : detect_grid_and_spacing(patches, grids[0], t.gp);
+    if (g.fr != FailureReason::NONE) return g;
+    for (const auto& gd : grids) {
+        const CoverageResult cov = compute_coverage_from_grid(gd.grid, e.size);
+        g.grids.push_back(GridGeom{gd.cvx, gd.cvy, cov.ratio, cov.hull_area <= 0.0 || cov.image_area <= 0.0});
+    }
+    return g;
+}
+
+// Same outcome process_image would report: first accepted grid, if any.
+bool decide(const ImageEntry& e, const ImageGeom& g, const GridParams& gp, double& ratio) {
+    if (!prefilter_passes_t(e.thumb, default_segmentation_params(), gp.coverage_thresh)) return false;   // FEW_PATCHES
+    if (g.fr != FailureReason::NONE) return false;
+    for (const auto& gr : g.grids) {
+        if (gr.bad) continue;
+        const bool spacing_ok = gr.cvx <= gp.cvx_thresh && gr.cvy <= gp.cvy_thresh;
+        if (grid_accepted(spacing_ok, gr.cvx, gr.cvy, gr.ratio, gp)) { ratio = gr.ratio; return true; }
+    }
+    return false;
+}
+
+struct Score {
+    int fp = 0, fn = 0;
+    double pct_err = 0.0;           // summed |percent - label| over labeled true positives
+    int pct_n = 0;
+    int errors() const { return fp + fn; }
+    double mae() const { return pct_n ? pct_err / pct_n : 0.0; }
+};
+
+template<class F>
+void parallel_for_n(size_t n, int threads, F f) {
+    std::atomic<size_t> next{0};
+    auto work = [&] { for (size_t i; (i = next.fetch_add(1)) < n;) f(i); };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads && (size_t)t < n; ++t) pool.emplace_back(work);
+    work();
+    for (auto& th : pool) th.join();
+}
+
+void usage() {
+    std::cerr << "usage: marker_tune --truth labels.tsv [--patches file] [--multi] [--threads N]\n"
+                 "                   [--top K] [--out trials.tsv] [--sweep name=lo:hi:step|name=v1,v2]...\n"
+                 "sweepable: cvx_thresh cvy_thresh coverage_thresh coverage_fallback coverage_soft\n"
+                 "           min_area_ratio max_area_ratio group_link min_colors area_compat\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string truth_path, store_path = "patches.bin", out_path;
+    bool multi = false;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    size_t top = 10;
+    std::vector<Axis> axes;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--truth" && i + 1 < argc) { truth_path = argv[++i]; continue; }
+        if (a == "--patches" && i + 1 < argc) { store_path = argv[++i]; continue; }
+        if (a == "--out" && i + 1 < argc) { out_path = argv[++i]; continue; }
+        if (a == "--multi") { multi = true; continue; }
+        if (a == "--threads" && i + 1 < argc) { threads = std::max(1, std::atoi(argv[++i])); continue; }
+        if (a == "--top" && i + 1 < argc) { top = (size_t)std::max(1, std::atoi(argv[++i])); continue; }
+        if (a == "--sweep" && i + 1 < argc) {
+            Axis ax;
+            if (!parse_axis(argv[++i], ax)) { std::cerr << "invalid --sweep " << argv[i] << "\n"; usage(); return 1; }
+            axes.push_back(std::move(ax));
+            continue;
+        }
+        usage();
+        return 1;
+    }
+    std::vector<Truth> truth;
+    if (truth_path.empty() || !read_truth(truth_path, truth) || truth.empty()) { usage(); return 1; }
+
+    const auto t0 = std::chrono::steady_clock::now();
+    cv::setNumThreads(1);   // parallelism is across images/trials, not inside OpenCV
+
+    // 1) Patch lists: from the store when the file bytes are unchanged.
+    std::map<std::string, ImageEntry> stored;
+    load_store(store_path, stored);
+    std::vector<ImageEntry> entries(truth.size());
+    std::vector<char> valid(truth.size(), 0), fresh(truth.size(), 0);
+    parallel_for_n(truth.size(), threads, [&](size_t i) {
+        const std::string& path = truth[i].path;
+        MappedFile mf;
+        if (!mf.open(path) || mf.size() == 0) return;
+        const uint64_t h = hash64(mf.data(), mf.size());
+        auto it = stored.find(path);
+        if (it != stored.end() && it->second.hash == h) { entries[i] = it->second; valid[i] = 1; return; }
+
+        cv::Mat img = cv::imdecode(cv::Mat(1, (int)mf.size(), CV_8U, const_cast<unsigned char*>(mf.data())), cv::IMREAD_COLOR);
+        if (img.empty()) return;
+        SegmentationParams all;
+        all.min_area_ratio = 0.0;   // keep every contour; trials apply their own filter
+        all.max_area_ratio = 1.0;
+        entries[i] = ImageEntry{path, h, img.size(), segment_color_patches(img, all),
+                                prefilter_counts_t<DefaultPalette>(img, default_segmentation_params())};
+        valid[i] = fresh[i] = 1;
+    });
+    size_t n_fresh = 0;
+    {
+        std::vector<Truth> kept_truth;
+        std::vector<ImageEntry> kept;
+        for (size_t i = 0; i < truth.size(); ++i) {
+            if (!valid[i]) { std::cerr << truth[i].path << " is not a valid picture path\n"; continue; }
+            n_fresh += fresh[i];
+            kept_truth.push_back(truth[i]);
+            kept.push_back(std::move(entries[i]));
+        }
+        truth.swap(kept_truth);
+        entries.swap(kept);
+    }
+    if (entries.empty()) return 1;
+    if (n_fresh && !save_store(store_path, entries)) std::cerr << "cannot write " << store_path << "\n";
+
+    // 2) Trials = cartesian product of the axes (defaults for the rest).
+    std::vector<TrialParams> trials(1);
+    for (const auto& ax : axes) {
+        std::vector<TrialParams> next;
+        next.reserve(trials.size() * ax.values.size());
+        for (const auto& t : trials)
+            for (double v : ax.values) { next.push_back(t); set_param(next.back(), ax.name, v); }
+        trials.swap(next);
+    }
+
+    // 3) Geometry once per distinct (area filter, group_link, pre-checks).
+    std::map<std::tuple<double, double, float, int, float>, int> key_index;
+    std::vector<TrialParams> keys;
+    std::vector<int> trial_key(trials.size());
+    for (size_t t = 0; t < trials.size(); ++t) {
+        auto k = std::make_tuple(trials[t].min_area_ratio, trials[t].max_area_ratio, multi ? trials[t].gp.group_link : 0.f,
+                                 trials[t].gp.min_colors, trials[t].gp.area_compat);
+        auto ins = key_index.emplace(k, (int)keys.size());
+        if (ins.second) keys.push_back(trials[t]);
+        trial_key[t] = ins.first->second;
+    }
+    const size_t n_img = entries.size();
+    std::vector<ImageGeom> geom(keys.size() * n_img);
+    parallel_for_n(geom.size(), threads, [&](size_t j) {
+        geom[j] = compute_geometry(entries[j % n_img], keys[j / n_img], multi);
+    });
+
+    // 4) Decisions per trial.
+    std::vector<Score> scores(trials.size());
+    parallel_for_n(trials.size(), threads, [&](size_t t) {
+        Score s;
+        const ImageGeom* g = &geom[(size_t)trial_key[t] * n_img];
+        for (size_t i = 0; i < n_img; ++i) {
+            double ratio = 0.0;
+            const bool ok = decide(entries[i], g[i], trials[t].gp, ratio);
+            if (ok && !truth[i].ok) ++s.fp;
+            if (!ok && truth[i].ok) ++s.fn;
+            if (ok && truth[i].ok && truth[i].pct >= 0) {
+                s.pct_err += std::abs(std::lround(ratio * 100.0) - (long)truth[i].pct);
+                ++s.pct_n;
+            }
+        }
+        scores[t] = s;
+    });
+
+    std::vector<size_t> order(trials.size());
+    for (size_t t = 0; t < order.size(); ++t) order[t] = t;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (scores[a].errors() != scores[b].errors()) return scores[a].errors() < scores[b].errors();
+        return scores[a].mae() < scores[b].mae();
+    });
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    auto write_table = [&](std::ostream& os, size_t rows) {
+        os << "rank\terrors\tfp\tfn\tpct_mae";
+        for (const auto& ax : axes) os << '\t' << ax.name;
+        os << '\n';
+        for (size_t r = 0; r < rows; ++r) {
+            const size_t t = order[r];
+            const Score& s = scores[t];
+            os << r + 1 << '\t' << s.errors() << '\t' << s.fp << '\t' << s.fn << '\t'
+               << std::fixed << std::setprecision(2) << s.mae();
+            os.unsetf(std::ios::floatfield);
+            for (const auto& ax : axes) os << '\t' << get_param(trials[t], ax.name);
+            os << '\n';
+        }
+    };
+
+    std::cout << "[tune] " << n_img << " images (" << (n_img - n_fresh) << " from " << store_path
+              << ", " << n_fresh << " segmented), " << keys.size() << " geometry variants, "
+              << trials.size() << " trials, " << threads << " threads, " << secs << " s\n";
+    write_table(std::cout, std::min(top, order.size()));
+    if (!out_path.empty()) {
+        std::ofstream os(out_path, std::ios::trunc);
+        if (!os) { std::cerr << "cannot write " << out_path << "\n"; return 1; }
+        write_table(os, order.size());
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+// prefilter_check.cpp - the thumbnail pre-rejection must never drop a marker.
+//
+//   prefilter_check inputs...
+//
+// Inputs are image files or directories (their regular, non-hidden files, not
+// recursive, in name order). Every image goes through the full pipeline with
+// the prefilter disabled and through prefilter_may_contain_marker with the
+// default parameters; an image the pipeline accepts but the prefilter rejects
+// is a failure (exit 1). Registered as a CTest over data/.
+#include "types.hpp"
+#include "color_segmentation.hpp"
+#include "grid_detector.hpp"
+#include "pipeline.hpp"
+#include "prefilter.hpp"
+#include "tool_inputs.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: prefilter_check inputs...\n";
+        return 1;
+    }
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) add_input(argv[i], inputs);
+
+    const SegmentationParams segp = default_segmentation_params();
+    const GridParams gp = default_grid_params();
+    SegmentationParams full = segp;
+    full.prefilter_side = 0;
+
+    int checked = 0, accepted = 0, dropped = 0;
+    for (const std::string& path : inputs) {
+        cv::Mat img = cv::imread(path, cv::IMREAD_COLOR);
+        if (img.empty()) { std::cerr << path << ": cannot decode, skipped\n"; continue; }
+        ++checked;
+        const bool pass = prefilter_may_contain_marker(img, segp, gp.coverage_thresh);
+        const ImageResult r = process_image(img, full, gp);
+        if (r.ok) ++accepted;
+        std::cout << path << "\tprefilter=" << (pass ? "pass" : "reject")
+                  << "\tpipeline=" << (r.ok ? "accept" : fr_to_cstr(r.fr)) << "\n";
+        if (r.ok && !pass) {
+            ++dropped;
+            std::cerr << path << ": accepted by the pipeline but rejected by the prefilter\n";
+        }
+    }
+    std::cout << "checked=" << checked << " accepted=" << accepted << " dropped_by_prefilter=" << dropped << "\n";
+    return (checked == 0 || dropped > 0) ? 1 : 0;
+}
@@ -0,0 +1,74 @@
+# shard_check.cmake - N shard runs merged must report what one full run reports.
+#
+#   cmake -DEXE=<SodyoAssignment> -DDATA=<dir> [-DSHARDS=3] [-DWORK=<dir>] -P shard_check.cmake
+#
+# Runs SodyoAssignment --shard i/N --results shard<i>.tsv over every image in
+# DATA, one process per shard, then once without --shard. The two --merge
+# reports must list the same images with the same percent and reason, and the
+# same summary. Latency and memory lines change from run to run and are not
+# compared. A path claimed by two shards or by none also fails. Registered as
+# a CTest (shard_merge_matches).
+if(NOT EXE OR NOT DATA)
+  message(FATAL_ERROR "usage: cmake -DEXE=<SodyoAssignment> -DDATA=<dir> [-DSHARDS=N] [-DWORK=<dir>] -P shard_check.cmake")
+endif()
+if(NOT SHARDS)
+  set(SHARDS 3)
+endif()
+if(NOT WORK)
+  set(WORK "${CMAKE_CURRENT_BINARY_DIR}/shard_check")
+endif()
+file(REMOVE_RECURSE "${WORK}")
+file(MAKE_DIRECTORY "${WORK}")
+
+file(GLOB images LIST_DIRECTORIES false "${DATA}/*.png" "${DATA}/*.jpg" "${DATA}/*.jpeg")
+list(SORT images)
+list(LENGTH images n_images)
+if(n_images EQUAL 0)
+  message(FATAL_ERROR "no images in ${DATA}")
+endif()
+
+# The exit code of a run is the pass/fail verdict of its images, not an error.
+set(shard_files "")
+math(EXPR last "${SHARDS} - 1")
+foreach(i RANGE ${last})
+  execute_process(COMMAND "${EXE}" --shard ${i}/${SHARDS} --results "${WORK}/shard${i}.tsv" ${images}
+                  OUTPUT_QUIET ERROR_QUIET)
+  if(NOT EXISTS "${WORK}/shard${i}.tsv")
+    message(FATAL_ERROR "shard ${i}/${SHARDS} wrote no results")
+  endif()
+  list(APPEND shard_files "${WORK}/shard${i}.tsv")
+endforeach()
+execute_process(COMMAND "${EXE}" --results "${WORK}/all.tsv" ${images} OUTPUT_QUIET ERROR_QUIET)
+
+execute_process(COMMAND "${EXE}" --merge ${shard_files} OUTPUT_VARIABLE merged ERROR_VARIABLE merged_err)
+execute_process(COMMAND "${EXE}" --merge "${WORK}/all.tsv" OUTPUT_VARIABLE single ERROR_VARIABLE single_err)
+if(merged_err MATCHES "warning|not a readable" OR single_err MATCHES "not a readable")
+  message(FATAL_ERROR "merge reported problems:\n${merged_err}${single_err}")
+endif()
+
+# Per-image lines and the summary; drop the latency/memory percentiles.
+function(verdicts report out)
+  string(REPLACE "\n" ";" lines "${report}")
+  set(kept "")
+  foreach(line IN LISTS lines)
+    if(line MATCHES "^(Latency ms|Peak memory KB):" OR line STREQUAL "")
+      continue()
+    endif()
+    list(APPEND kept "${line}")
+  endforeach()
+  set(${out} "${kept}" PARENT_SCOPE)
+endfunction()
+verdicts("${merged}" merged_lines)
+verdicts("${single}" single_lines)
+
+if(NOT merged_lines STREQUAL single_lines)
+  string(REPLACE ";" "\n" a "${merged_lines}")
+  string(REPLACE ";" "\n" b "${single_lines}")
+  message(FATAL_ERROR "${SHARDS} shards merged differ from one run:\n--- merged\n${a}\n--- single\n${b}")
+endif()
+list(LENGTH single_lines n_lines)
+math(EXPR n_rows "${n_lines} - 1")
+if(NOT n_rows EQUAL n_images)
+  message(FATAL_ERROR "${n_images} images in, ${n_rows} results out")
+endif()
+message(STATUS "${SHARDS} shards merged match one run over ${n_images} images")
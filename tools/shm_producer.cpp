@@ -0,0 +1,153 @@
+// shm_producer.cpp - local stand-in for the capture daemon (--shm testing).
+//
+//   shm_producer <name> [--slots N] [--fps F] [--loops K] [--drop] [--yuv nv12|i420] images...
+//
+// Creates the frame ring <name> and the results ring <name>.results, then
+// publishes the images (resized to the first one's size) as frames, K times
+// over. --yuv publishes 4:2:0 frames like a camera or hardware decoder would
+// (the size is rounded down to even). Default is to wait for a free slot; --drop skips the frame instead,
+// like a live camera would. Results coming back are printed as they arrive.
+// Start it first, then: SodyoAssignment --shm <name>
+#include "shm_ring.hpp"
+#include "types.hpp"
+#include "yuv_frame.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using steady = std::chrono::steady_clock;
+
+static uint64_t now_ns() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(steady::now().time_since_epoch()).count();
+}
+
+// Prints every result currently in the ring; returns how many.
+static uint64_t drain_results(ShmRing& results) {
+    uint64_t n = 0;
+    ShmRing::SlotMeta meta;
+    while (unsigned char* p = results.try_read(meta)) {
+        ShmResult r;
+        std::memcpy(&r, p, sizeof(r));
+        results.end_read();
+        const double e2e_ms = (double)(now_ns() - r.timestamp_ns) / 1e6;
+        std::cout << "frame " << r.frame_seq << ": ";
+        if (r.ok) for (int i = 0; i < r.n_markers; ++i) std::cout << (int)std::lround(r.pct[i]) << "% ";
+        else      std::cout << "0% " << fr_to_cstr((FailureReason)r.reason) << " ";
+        std::cout << "(detect " << r.ms << " ms, end-to-end " << e2e_ms << " ms)\n";
+        ++n;
+    }
+    return n;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: shm_producer <name> [--slots N] [--fps F] [--loops K] [--drop] [--yuv nv12|i420] images...\n";
+        return 1;
+    }
+    const std::string name = argv[1];
+    uint32_t slots = 8;
+    double fps = 0.0;     // 0 = as fast as the consumer takes them
+    int loops = 1;
+    bool drop = false;
+    YuvFormat yuv = YuvFormat::None;
+    std::vector<cv::Mat> frames;
+    for (int i = 2; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--slots" && i + 1 < argc) { slots = (uint32_t)std::max(1, std::atoi(argv[++i])); continue; }
+        if (a == "--fps" && i + 1 < argc) { fps = std::atof(argv[++i]); continue; }
+        if (a == "--loops" && i + 1 < argc) { loops = std::max(1, std::atoi(argv[++i])); continue; }
+        if (a == "--drop") { drop = true; continue; }
+        if (a == "--yuv" && i + 1 < argc) {
+            if (!parse_yuv_format(argv[++i], yuv)) { std::cerr << "--yuv takes nv12 or i420\n"; return 1; }
+            continue;
+        }
+        cv::Mat img = cv::imread(a, cv::IMREAD_COLOR);
+        if (img.empty()) { std::cerr << a << " is not a valid picture path\n"; continue; }
+        // the ring has one fixed frame size: the first image's
+        if (!frames.empty() && img.size() != frames.front().size()) cv::resize(img, img, frames.front().size());
+        frames.push_back(img);
+    }
+    if (frames.empty()) return 1;
+
+    cv::Size sz = frames.front().size();
+    ShmRing::Layout fl;
+    fl.slots = slots;
+    if (yuv != YuvFormat::None) {
+        sz = cv::Size(sz.width & ~1, sz.height & ~1);
+        if (sz.area() == 0) { std::cerr << "frames too small for 4:2:0\n"; return 1; }
+        for (cv::Mat& f : frames) {
+            cv::Mat y;
+            bgr_to_yuv(f(cv::Rect(0, 0, sz.width, sz.height)).clone(), yuv, y);
+            f = y;
+        }
+        fl.type = CV_8UC1;
+        fl.yuv = (uint32_t)yuv;
+        fl.step = (uint32_t)sz.width;
+        fl.payload_bytes = fl.step * (uint32_t)sz.height * 3 / 2;
+    }
+    else {
+        fl.type = CV_8UC3;
+        fl.step = (uint32_t)sz.width * 3;
+        fl.payload_bytes = fl.step * (uint32_t)sz.height;
+    }
+    fl.width = sz.width;
+    fl.height = sz.height;
+    ShmRing::Layout rl;
+    rl.slots = 4 * slots;
+    rl.payload_bytes = sizeof(ShmResult);
+
+    ShmRing ring, results;
+    // results first: a consumer that finds the frame ring also finds its results ring
+    if (!results.create(shm_results_name(name), rl) || !ring.create(name, fl)) {
+        std::cerr << "cannot create shared memory ring " << name << "\n";
+        results.unlink();
+        return 1;
+    }
+
+    const auto period = fps > 0 ? std::chrono::nanoseconds((long long)(1e9 / fps)) : std::chrono::nanoseconds(0);
+    auto next = steady::now();
+    uint64_t seq = 0, received = 0;
+    for (int loop = 0; loop < loops; ++loop) {
+        for (const cv::Mat& f : frames) {
+            if (period.count()) { std::this_thread::sleep_until(next); next += period; }
+            ShmRing::SlotMeta* meta = nullptr;
+            unsigned char* slot = ring.try_write(meta);
+            while (!slot && !drop) {
+                received += drain_results(results);
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                slot = ring.try_write(meta);
+            }
+            if (!slot) { ring.count_drop(); ++seq; continue; }
+            for (int y = 0; y < f.rows; ++y) std::memcpy(slot + (size_t)y * fl.step, f.ptr(y), fl.step);
+            meta->seq = seq++;
+            meta->timestamp_ns = now_ns();
+            ring.commit_write();
+            received += drain_results(results);
+        }
+    }
+    ring.mark_closed();
+
+    // Wait for the consumer to finish the queued frames (or give up after 10 s
+    // without progress, e.g. when no consumer is attached).
+    const uint64_t expected = ring.written();
+    auto last_progress = steady::now();
+    while (received + results.dropped() < expected && steady::now() - last_progress < std::chrono::seconds(10)) {
+        const uint64_t n = drain_results(results);
+        if (n) { received += n; last_progress = steady::now(); }
+        else std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::cout << "\nProducer: sent=" << expected << " dropped=" << ring.dropped()
+              << " results=" << received << " (consumer could not publish " << results.dropped() << ")\n";
+    ring.unlink();
+    results.unlink();
+    return received + results.dropped() == expected ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+// strip_check.cpp - strip segmentation must find the whole-image patches.
+//
+//   strip_check inputs...
+//
+// Inputs are image files or directories (their regular, non-hidden files, not
+// recursive, in name order). Each image is segmented whole and in strips of
+// 7, 16 and 37 rows, skipping a height that divides the image: the last strip
+// is always short, the case where window ROIs used to read stale rows. Masks
+// must match exactly, so every patch clear of the area bounds has to appear in
+// both lists with the same color and bounding box. Areas are not compared:
+// strips count pixels where the whole-image path measures contours
+// (strip_segmentation.hpp), so patches near min_area may legitimately appear
+// in one list only. Exit 1 on any mismatch. Registered as a CTest over data/.
+#include "types.hpp"
+#include "color_segmentation.hpp"
+#include "pipeline.hpp"
+#include "strip_segmentation.hpp"
+#include "strip_source.hpp"
+#include "tool_inputs.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Patches of `from` with area in [lo, hi] that have no same-color, same-box
+// patch in `in`.
+static int unmatched(const std::vector<Patch>& from, const std::vector<Patch>& in, double lo, double hi,
+                     const std::string& what) {
+    int n = 0;
+    for (const Patch& p : from) {
+        if (p.area < lo || p.area > hi) continue;
+        const bool found = std::any_of(in.begin(), in.end(), [&](const Patch& q) {
+            return p.color == q.color && p.box == q.box;
+        });
+        if (found) continue;
+        ++n;
+        std::cerr << "  " << what << ": " << p.color << " box " << p.box.x << "," << p.box.y << " " << p.box.width << "x" << p.box.height << " area " << p.area << "\n";
+    }
+    return n;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: strip_check inputs...\n";
+        return 1;
+    }
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) add_input(argv[i], inputs);
+
+    SegmentationParams segp = default_segmentation_params();
+    segp.prefilter_side = 0;
+    const int kStripRows[] = {7, 16, 37};
+
+    int runs = 0, failed = 0;
+    for (const std::string& path : inputs) {
+        cv::Mat img = cv::imread(path, cv::IMREAD_COLOR);
+        if (img.empty()) { std::cerr << path << ": cannot decode, skipped\n"; continue; }
+        const double img_area = (double)img.total();
+        const double min_area = segp.min_area_ratio * img_area, max_area = segp.max_area_ratio * img_area;
+        const std::vector<Patch> whole = segment_color_patches(img, segp);
+
+        for (int rows : kStripRows) {
+            if (rows >= img.rows || img.rows % rows == 0) continue;
+            ++runs;
+            auto src = strip_source_from_mat(img);
+            const std::vector<Patch> strips = segment_color_patches_strips(*src, segp, rows);
+            // Margins keep both area measures inside the bounds: contour area
+            // is below the pixel count by about half the perimeter.
+            const int bad = unmatched(whole, strips, 2 * min_area, 0.5 * max_area, "whole only") +
+                            unmatched(strips, whole, 3 * min_area, 0.5 * max_area, "strips only");
+            std::cout << path << "\tstrip_rows=" << rows << "\twhole=" << whole.size()
+                      << "\tstrips=" << strips.size() << "\tunmatched=" << bad << "\n";
+            if (bad) ++failed;
+        }
+    }
+    std::cout << "runs=" << runs << " failed=" << failed << "\n";
+    return (runs == 0 || failed > 0) ? 1 : 0;
+}
@@ -0,0 +1,22 @@
+#pragma once
+// Input lists shared by the tools/ executables.
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// A file is taken as given; a directory adds its regular, non-hidden files
+// (not recursive) in name order.
+inline void add_input(const std::string& arg, std::vector<std::string>& out) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (!fs::is_directory(arg, ec)) { out.push_back(arg); return; }
+    std::vector<std::string> files;
+    for (const auto& de : fs::directory_iterator(arg, ec)) {
+        const std::string name = de.path().filename().string();
+        if (!name.empty() && name[0] != '.' && de.is_regular_file(ec)) files.push_back(de.path().string());
+    }
+    std::sort(files.begin(), files.end());
+    out.insert(out.end(), files.begin(), files.end());
+}
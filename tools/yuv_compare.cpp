@@ -0,0 +1,99 @@
+// yuv_compare.cpp - the YUV segmentation path against the BGR one.
+//
+//   yuv_compare [--multi] inputs...
+//
+// Inputs are image files or directories (their regular, non-hidden files, not
+// recursive, in name order). Each image goes to I420 and is segmented from
+// the planes (segment_color_patches_yuv, process_image_yuv) and, as a camera
+// frame is without the YUV path, converted back to BGR and segmented as
+// usual. Patches pair up by color, centers within 2% of the diagonal and
+// areas within 25%. Per image: both patch counts, the matched pairs and both
+// results. Exit 0 when every accept/reject decision agrees and at least
+// kMinMatched of the BGR patches have a YUV match; registered as a CTest over
+// data/. The two paths blur in different spaces (HSV vs Y/U/V), and on small
+// images a patch of a few pixels moves past the area tolerance easily: the BGR
+// path itself keeps only about 85% of its patches through the I420 round trip.
+// The sample images give about 72%.
+#include "types.hpp"
+#include "color_segmentation.hpp"
+#include "grid_detector.hpp"
+#include "pipeline.hpp"
+#include "yuv_frame.hpp"
+#include "tool_inputs.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static const double kMinMatched = 0.65;   // matched / BGR patches
+
+static int compare_yuv(const std::vector<std::string>& images, const SegmentationParams& segp,
+                       const GridParams& gp, bool multi) {
+    size_t n = 0, agree = 0, n_bgr = 0, n_yuv = 0, matched = 0;
+    for (const auto& path : images) {
+        cv::Mat img = cv::imread(path, cv::IMREAD_COLOR);
+        if (img.cols < 2 || img.rows < 2) { std::cerr << path << " cannot be decoded\n"; continue; }
+        img = img(cv::Rect(0, 0, img.cols & ~1, img.rows & ~1));
+        cv::Mat yuv, bgr;
+        bgr_to_yuv(img, YuvFormat::I420, yuv);
+        yuv_to_bgr(yuv, YuvFormat::I420, bgr);
+        YuvPlanes planes;
+        yuv_planes(yuv, YuvFormat::I420, planes);
+
+        const std::vector<Patch> pb = segment_color_patches(bgr, segp);
+        const std::vector<Patch> py = segment_color_patches_yuv(planes, segp);
+        const double tol = 0.02 * std::hypot((double)img.cols, (double)img.rows);
+        std::vector<bool> used(py.size(), false);
+        size_t m = 0;
+        for (const Patch& a : pb)
+            for (size_t j = 0; j < py.size(); ++j) {
+                const Patch& b = py[j];
+                if (used[j] || a.color != b.color || cv::norm(a.center - b.center) > tol ||
+                    std::abs(a.area - b.area) > 0.25 * std::max(a.area, b.area))
+                    continue;
+                used[j] = true;
+                ++m;
+                break;
+            }
+
+        const ImageResult rb = process_image(bgr, segp, gp, multi);
+        const ImageResult ry = process_image_yuv(planes, segp, gp, multi);
+        auto pct = [](const ImageResult& r) {
+            return r.ok ? (int)std::lround(r.markers.front().cov.ratio * 100.0) : 0;
+        };
+        std::cout << path << " patches bgr=" << pb.size() << " yuv=" << py.size() << " matched=" << m
+            << " result bgr=" << pct(rb) << "% yuv=" << pct(ry) << "%"
+            << (rb.ok != ry.ok ? " DIFFERS" : "") << "\n";
+        ++n;
+        agree += rb.ok == ry.ok;
+        n_bgr += pb.size();
+        n_yuv += py.size();
+        matched += m;
+    }
+    const double matched_frac = n_bgr ? (double)matched / (double)n_bgr : 0.0;
+    std::cout << "\nYUV compare: images=" << n << " patches bgr=" << n_bgr << " yuv=" << n_yuv
+        << " matched=" << matched << " (" << std::lround(matched_frac * 100.0) << "%, at least "
+        << std::lround(kMinMatched * 100.0) << "% needed) decisions_agree=" << agree << " of " << n << std::endl;
+    return (n > 0 && agree == n && matched_frac >= kMinMatched) ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    bool multi = false;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--multi") { multi = true; continue; }
+        add_input(a, inputs);
+    }
+    if (inputs.empty()) {
+        std::cerr << "usage: yuv_compare [--multi] inputs...\n";
+        return 1;
+    }
+
+    const SegmentationParams segp = default_segmentation_params();
+    const GridParams gp = default_grid_params();
+    return compare_yuv(inputs, segp, gp, multi);
+}